@@ -0,0 +1,200 @@
+// $Id$
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+#include "batch.h"
+#include "commands.h"
+#include "debug.h"
+#include "locks.h"
+
+// running_index -
+//    The command a worker thread is running, for provisional_number,
+//    which allocate calls with no arguments.
+
+static thread_local size_t running_index {0};
+
+batch::batch (inode_state& state_, size_t workers_):
+              state (state_), workers (workers_) {
+}
+
+bool batch::schedulable (const vector<string_view>& words) {
+   if (words.size() < 2 or (words[0] != "mkdir" and words[0] != "make")) {
+      return false;
+   }
+   for (string_view name: path_names (words[1])) {
+      if (name == "..") return false;
+   }
+   return true;
+}
+
+void batch::add (const vector<string_view>& words) {
+   jobs.emplace_back();
+   jobs.back().words.assign (words.begin(), words.end());
+}
+
+// parallel -
+//    Pathnames are taken from the cwd by its path, so an orphaned cwd,
+//    which the path does not lead back to, rules the workers out too.
+
+bool batch::parallel() const {
+   if (workers < 2 or jobs.size() < MIN_PARALLEL) return false;
+   if (state.has_snapshots() or debugflags::any()) return false;
+   const inode* cwd = state.get_cwd().get();
+   const string& path = cwd->get_directory()->get_path();
+   return state.get_root()->get_directory()->resolve (path).node == cwd;
+}
+
+// link -
+//    Builds the graph of which command waits for which, through a trie
+//    of the pathnames.  Each node records the last command that named
+//    it, and the commands since then that named something below it.
+//    A command waits for the last one at each node on its way down,
+//    and for everything below its own node since the last there.  It
+//    then becomes the last at its node, and is below every node above.
+//    Waiting on the last command at a node is enough, since that one
+//    waited in turn for every earlier command at or below that node.
+
+void batch::link() {
+   static constexpr size_t NONE = SIZE_MAX;
+   struct node {
+      unordered_map<string_view, size_t> children;
+      size_t last {NONE};
+      vector<size_t> inside;
+   };
+   vector<node> trie (1);
+   const string& cwd = state.get_cwd()->get_directory()->get_path();
+   vector<string_view> names;
+   vector<size_t> waits_for;
+   for (size_t index = 0; index < jobs.size(); ++index) {
+      const string& operand = jobs[index].words[1];
+      names.clear();
+      if (operand.empty() or operand.front() != '/') {
+         for (string_view name: path_names (cwd)) names.push_back (name);
+      }
+      for (string_view name: path_names (operand)) {
+         if (name != ".") names.push_back (name);
+      }
+      waits_for.clear();
+      size_t at = 0;
+      for (string_view name: names) {
+         if (trie[at].last != NONE) waits_for.push_back (trie[at].last);
+         trie[at].inside.push_back (index);
+         auto found = trie[at].children.emplace (name, trie.size());
+         size_t next = found.first->second;
+         if (found.second) trie.emplace_back();
+         at = next;
+      }
+      node& here = trie[at];
+      if (here.last != NONE) waits_for.push_back (here.last);
+      waits_for.insert (waits_for.end(), here.inside.begin(),
+                        here.inside.end());
+      here.inside.clear();
+      here.last = index;
+      for (size_t before: waits_for) {
+         jobs[before].dependents.push_back (index);
+      }
+      jobs[index].waiting = waits_for.size();
+   }
+}
+
+void batch::execute (job& command) {
+   try {
+      find_command_fn (command.words[0]) (state, command.words);
+   }catch (command_error& error) {
+      command.error = error.what();
+   }catch (...) {
+      command.failure = current_exception();
+   }
+}
+
+// work -
+//    A worker takes the earliest command that is ready.  Other workers
+//    are woken only when there is something new for them to take.
+
+void batch::work (vector<directory::totals_change>& totals) {
+   inode_numbers::set_source (provisional_number);
+   directory::log_totals (&totals);
+   unique_lock<mutex> held (lock);
+   for (;;) {
+      changed.wait (held, [this] {
+         return not ready.empty() or finished == jobs.size();
+      });
+      if (ready.empty()) break;
+      pop_heap (ready.begin(), ready.end(), greater<size_t>());
+      size_t index = ready.back();
+      ready.pop_back();
+      held.unlock();
+      running_index = index;
+      execute (jobs[index]);
+      held.lock();
+      bool more = ++finished == jobs.size();
+      for (size_t next: jobs[index].dependents) {
+         if (--jobs[next].waiting > 0) continue;
+         ready.push_back (next);
+         push_heap (ready.begin(), ready.end(), greater<size_t>());
+         more = true;
+      }
+      if (more) changed.notify_all();
+   }
+   directory::log_totals (nullptr);
+   inode_numbers::set_source (nullptr);
+}
+
+inode_nr_t batch::provisional_number() {
+   return inode_numbers::PROVISIONAL + running_index;
+}
+
+// run -
+//    The workers leave out what would make them wait for each other
+//    or for the order of the script, and the calling thread catches
+//    up once they are done: it numbers the inodes they made, in the
+//    order of the script, from its own batch of numbers, and applies
+//    the changes they logged to the totals.  Every command runs, in
+//    either mode, even after one has failed, since the workers may
+//    already have run later ones by then; the first failure is thrown
+//    on once every error has been reported.
+
+void batch::run() {
+   if (jobs.empty()) return;
+   if (parallel()) {
+      link();
+      ready.clear();
+      finished = 0;
+      for (size_t index = 0; index < jobs.size(); ++index) {
+         if (jobs[index].waiting == 0) ready.push_back (index);
+      }
+      inode_table::set_aside (jobs.size());
+      vector<vector<directory::totals_change>> totals (workers);
+      locks::set_threaded (true);
+      vector<thread> pool;
+      for (size_t count = 0; count < workers; ++count) {
+         pool.emplace_back ([this, &totals, count] {
+            work (totals[count]);
+         });
+      }
+      for (auto& worker: pool) worker.join();
+      locks::set_threaded (false);
+      for (size_t index = 0; index < jobs.size(); ++index) {
+         inode_table::settle (index);
+      }
+      inode_table::set_aside (0);
+      for (const auto& log: totals) directory::apply_totals (log);
+   }else {
+      for (auto& command: jobs) execute (command);
+   }
+
+   vector<job> done;
+   done.swap (jobs);
+   exception_ptr failure;
+   for (auto& command: done) {
+      if (not command.error.empty()) complain() << command.error << endl;
+      if (command.failure and not failure) failure = command.failure;
+   }
+   if (failure) rethrow_exception (failure);
+}
+
@@ -0,0 +1,108 @@
+// $Id$
+
+// batch -
+//    Runs the commands of a script that only add to the tree on a pool
+//    of worker threads, as many at once as do not depend on each other,
+//    with the same results and the same output as running them in
+//    order.
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+#include "numbers.h"
+#include "util.h"
+
+// class batch -
+//    Gathers mkdir and make commands, and runs them all when told to,
+//    which script::run, given two workers or more, does before any
+//    other command and at the end.
+//    Each command adds one entry, at the pathname it names.  Two
+//    commands depend on each other if one pathname is the same as the
+//    other or below it, taken lexically from the cwd, since then the
+//    later one walks through or collides with what the earlier made.
+//    Commands with no such link can run in either order with the same
+//    result, and the workers run them at once, locking the directories
+//    and tables they share (see locks).  A later command starts only
+//    once every earlier one it depends on has finished.
+//    Everything else that could tell the order apart is kept as it
+//    would be in order.  Errors are gathered and reported in the order
+//    of the script, once the batch is done.  Inode numbers, which ls
+//    prints, must come out in the order of the script, which the
+//    workers cannot know until every earlier command has finished.
+//    So each command makes its inode, if any, under a provisional
+//    number, its index in the batch, and once the workers are done,
+//    the inodes are given their real numbers in order of index (see
+//    inode_table::settle).  Each command makes one inode at most.
+//    The changes the commands make to directory totals are logged by
+//    each worker and applied at the end too, since each one walks up
+//    to the root, and the workers would take turns at the top of the
+//    tree.  Nothing reads either while the batch runs.
+//    The batch runs in order on the calling thread instead if it is
+//    small, if there is a snapshot, since changing a frozen inode
+//    copies every directory above it, or if debugging output is on.
+// schedulable -
+//    Whether a command may go in a batch: mkdir or make with a
+//    pathname that has no dotdot in it.
+// add -
+//    Gathers a command.
+// size -
+//    The number of commands gathered.
+// run -
+//    Runs the commands gathered, reports their errors, and empties
+//    the batch.  Every command is run, whether in order or not, even
+//    if an earlier one throws something other than a command_error.
+//    The first such exception is thrown on once the errors of all
+//    the commands have been reported, before and after it alike.
+// MAX_COMMANDS -
+//    How many commands are gathered at most before they are run.
+// MIN_PARALLEL -
+//    Fewer commands than this are run in order.
+// MAX_WORKERS -
+//    The most worker threads a batch may be given.
+
+class batch {
+   public:
+      static constexpr size_t MAX_COMMANDS = 1 << 14;
+      static constexpr size_t MIN_PARALLEL = 64;
+      static constexpr size_t MAX_WORKERS = 256;
+      batch (inode_state& state, size_t workers);
+      batch (const batch&) = delete;
+      batch& operator= (const batch&) = delete;
+      static bool schedulable (const vector<string_view>& words);
+      void add (const vector<string_view>& words);
+      size_t size() const { return jobs.size(); }
+      void run();
+   private:
+      struct job {
+         wordvec words;
+         vector<size_t> dependents;
+         size_t waiting {0};
+         string error;
+         exception_ptr failure;
+      };
+      inode_state& state;
+      size_t workers;
+      vector<job> jobs;
+      mutex lock;
+      condition_variable changed;
+      vector<size_t> ready;
+      size_t finished {0};
+      bool parallel() const;
+      void link();
+      void work (vector<directory::totals_change>& totals);
+      void execute (job& command);
+      static inode_nr_t provisional_number();
+};
+
+#endif
+
@@ -0,0 +1,115 @@
+// $Id$
+
+// bench_batch -
+//    Times a batch of mkdir and make commands building a tree, run in
+//    order and then on a pool of workers, each into a fresh tree.  The
+//    fastest of several runs of each is kept.  The listings of the two
+//    trees are checked to be the same, but for the inode numbers,
+//    since each tree takes its numbers from those the last one gave
+//    back, in whatever order it gave them.
+//    Usage: bench_batch [directories] [files-per-directory] [workers]
+//                       [runs]
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+#include "batch.h"
+#include "commands.h"
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static vector<string> commands (size_t ndirs, size_t nfiles) {
+   vector<string> lines;
+   for (size_t dir = 0; dir < ndirs; ++dir) {
+      string name = "/d" + to_string (dir);
+      lines.push_back ("mkdir " + name);
+      for (size_t file = 0; file < nfiles; ++file) {
+         lines.push_back ("make " + name + "/f" + to_string (file)
+                          + " some words");
+      }
+   }
+   return lines;
+}
+
+static double build (const vector<string>& lines, size_t workers,
+                     string& listing) {
+   inode_state state;
+   batch gathered (state, workers);
+   vector<string_view> views;
+   auto start = bench_clock::now();
+   for (const string& line: lines) {
+      views.clear();
+      size_t pos = 0;
+      while (pos < line.size()) {
+         size_t space = min (line.find (' ', pos), line.size());
+         views.emplace_back (line.data() + pos, space - pos);
+         pos = space + 1;
+      }
+      gathered.add (views);
+      if (gathered.size() == batch::MAX_COMMANDS) gathered.run();
+   }
+   gathered.run();
+   double seconds = seconds_since (start);
+   ostringstream gathered_listing;
+   streambuf* saved = cout.rdbuf (gathered_listing.rdbuf());
+   fn_lsr (state, {"lsr", "/"});
+   cout.rdbuf (saved);
+   listing.clear();
+   string line;
+   for (istringstream input (gathered_listing.str());
+        getline (input, line);) {
+      size_t number = line.find_first_not_of (' ');
+      if (number != string::npos and isdigit (line[number])) {
+         line.erase (0, line.find (' ', number));
+      }
+      listing += line + '\n';
+   }
+   return seconds;
+}
+
+static void report (const string& label, double seconds, size_t count) {
+   cout << left << setw (12) << label << right << fixed
+        << setprecision (4) << setw (10) << seconds << " s"
+        << setprecision (0) << setw (12) << count / seconds
+        << " commands/s" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t ndirs = argc > 1 ? strtoul (argv[1], nullptr, 10) : 256;
+   size_t nfiles = argc > 2 ? strtoul (argv[2], nullptr, 10) : 64;
+   size_t workers = argc > 3 ? strtoul (argv[3], nullptr, 10) : 4;
+   size_t runs = argc > 4 ? strtoul (argv[4], nullptr, 10) : 5;
+   vector<string> lines = commands (ndirs, nfiles);
+
+   double in_order = 1e9;
+   double pooled = 1e9;
+   string expected;
+   string listing;
+   for (size_t count = 0; count < runs; ++count) {
+      in_order = min (in_order, build (lines, 1, expected));
+      pooled = min (pooled, build (lines, workers, listing));
+   }
+
+   cout << lines.size() << " commands, " << workers << " workers, "
+        << (listing == expected ? "trees match" : "TREES DIFFER")
+        << endl;
+   report ("in order", in_order, lines.size());
+   report ("pooled", pooled, lines.size());
+   cout << setprecision (2) << "speedup " << in_order / pooled << endl;
+   return listing == expected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,113 @@
+// $Id$
+
+// bench_bigdir -
+//    Times a single directory's entries as the directory grows from
+//    ten entries to ten million: inserting them all, finding each by
+//    name, the first listing in order after they were inserted, and
+//    erasing them all.  Lists above dirent_list::HASH_MIN are hashed,
+//    so the times per entry should stay flat; a map of strings is
+//    timed alongside for comparison.  Each size is repeated until a
+//    million or so entries have been timed.
+//    Usage: bench_bigdir [max-entries] [max-entries-for-map]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "dirents.h"
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+// ROUND_ENTRIES -
+//    Small directories are built and taken apart over and over, until
+//    about this many entries have gone through, so that their times
+//    are not just the cost of reading the clock.
+
+static constexpr size_t ROUND_ENTRIES = 1'000'000;
+
+int main (int argc, char** argv) {
+   size_t max_entries = argc > 1 ? strtoul (argv[1], nullptr, 10)
+                                 : 10'000'000;
+   size_t max_map = argc > 2 ? strtoul (argv[2], nullptr, 10)
+                             : 1'000'000;
+   const auto node = inode::make (file_type::PLAIN_TYPE);
+
+   // The names are made and interned once, in a shuffled order, so
+   // that inserting them is not simply appending in sorted order.
+   wordvec names;
+   for (size_t i = 0; i < max_entries; ++i) {
+      names.push_back ("entry-" + to_string (i));
+   }
+   shuffle (names.begin(), names.end(), mt19937 (109));
+   vector<fname> interned (names.begin(), names.end());
+
+   cout << setw (10) << "entries" << setw (10) << "insert"
+        << setw (10) << "find" << setw (10) << "sort" << setw (10)
+        << "erase" << setw (12) << "map insert" << setw (10)
+        << "map find" << "   (ns per entry)" << endl;
+   for (size_t count = 10; count <= max_entries; count *= 10) {
+      size_t rounds = max<size_t> (1, ROUND_ENTRIES / count);
+      double insert = 0, find = 0, sort = 0, erase = 0;
+      size_t found = 0;
+      for (size_t round = 0; round < rounds; ++round) {
+         dirent_list list;
+         auto start = bench_clock::now();
+         for (size_t i = 0; i < count; ++i) {
+            list.insert (interned[i], node);
+         }
+         insert += seconds_since (start);
+
+         start = bench_clock::now();
+         for (size_t i = 0; i < count; ++i) {
+            found += list.find (string_view (names[i])) != list.end();
+         }
+         find += seconds_since (start);
+
+         start = bench_clock::now();
+         list.sort();
+         sort += seconds_since (start);
+
+         start = bench_clock::now();
+         for (size_t i = 0; i < count; ++i) list.erase (interned[i]);
+         erase += seconds_since (start);
+      }
+      double scale = 1e9 / (rounds * count);
+      cout << setw (10) << count << fixed << setprecision (1)
+           << setw (10) << insert * scale << setw (10) << find * scale
+           << setw (10) << sort * scale << setw (10) << erase * scale;
+      if (count <= max_map) {
+         double map_insert = 0, map_find = 0;
+         for (size_t round = 0; round < rounds; ++round) {
+            map<string,inode_ptr> reference;
+            auto start = bench_clock::now();
+            for (size_t i = 0; i < count; ++i) {
+               reference.emplace (names[i], node);
+            }
+            map_insert += seconds_since (start);
+            start = bench_clock::now();
+            for (size_t i = 0; i < count; ++i) {
+               found += reference.find (names[i]) != reference.end();
+            }
+            map_find += seconds_since (start);
+         }
+         cout << setw (12) << map_insert * scale << setw (10)
+              << map_find * scale;
+      }
+      cout << endl;
+      if (found < rounds * count) cout << "lost entries" << endl;
+   }
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+// $Id$
+
+// bench_bytecode -
+//    Writes a setup script that builds a tree with mkdir and make and
+//    then lists and enters its directories, compiles it, and times
+//    replaying the text and the bytecode into a fresh tree each time.
+//    The two take turns, and the fastest replay of each is kept, so
+//    that warming up the allocator favours neither.  Output goes to a
+//    stream that discards it.
+//    Usage: bench_bytecode [directories] [files-per-directory]
+//                          [replays]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#include "bytecode.h"
+#include "file_sys.h"
+#include "script.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+// discard -
+//    A stream buffer that throws away whatever is written to it.
+
+class discard: public streambuf {
+   protected:
+      int overflow (int letter) override { return letter; }
+      streamsize xsputn (const char*, streamsize count) override {
+         return count;
+      }
+};
+
+static size_t write_script (const string& filename, size_t ndirs,
+                            size_t nfiles) {
+   ofstream out (filename);
+   size_t lines = 0;
+   for (size_t dir = 0; dir < ndirs; ++dir) {
+      string path = "/top/d" + to_string (dir);
+      if (dir == 0) {
+         out << "mkdir /top\n";
+         ++lines;
+      }
+      out << "mkdir " << path << "\n";
+      ++lines;
+      for (size_t file = 0; file < nfiles; ++file) {
+         out << "make " << path << "/f" << file
+             << " some words for the file number " << file << "\n";
+         ++lines;
+      }
+   }
+   for (size_t dir = 0; dir < ndirs; ++dir) {
+      string path = "/top/d" + to_string (dir);
+      out << "# visit " << path << "\n"
+          << "cd " << path << "\n" << "ls\n" << "cat f0\n"
+          << "cd /\n" << "ls " << path << "\n";
+      lines += 5;
+   }
+   return lines;
+}
+
+static double replay (const string& filename) {
+   auto start = bench_clock::now();
+   inode_state state;
+   script (filename).run (state);
+   return seconds_since (start);
+}
+
+int main (int argc, char** argv) {
+   size_t ndirs = argc > 1 ? strtoul (argv[1], nullptr, 10) : 1000;
+   size_t nfiles = argc > 2 ? strtoul (argv[2], nullptr, 10) : 20;
+   size_t replays = argc > 3 ? strtoul (argv[3], nullptr, 10) : 10;
+   const string text = "/tmp/bench_bytecode.ysh";
+   const string code = "/tmp/bench_bytecode.ybc";
+   size_t lines = write_script (text, ndirs, nfiles);
+   auto start = bench_clock::now();
+   {
+      script input (text);
+      bytecode::compile (input, code);
+   }
+   double compiling = seconds_since (start);
+   size_t text_size = script (text).contents().size();
+   size_t code_size = script (code).contents().size();
+
+   discard nowhere;
+   streambuf* saved = cout.rdbuf (&nowhere);
+   double text_time = 1e9;
+   double code_time = 1e9;
+   for (size_t count = 0; count < replays; ++count) {
+      text_time = min (text_time, replay (text));
+      code_time = min (code_time, replay (code));
+   }
+   cout.rdbuf (saved);
+   remove (text.c_str());
+   remove (code.c_str());
+
+   cout << right << lines << " commands, " << text_size
+        << " bytes of text, " << code_size << " bytes of bytecode"
+        << endl;
+   cout << fixed << setprecision (3) << "compile: " << compiling
+        << " s" << endl;
+   cout << setprecision (0);
+   cout << setw (8) << "text" << setw (12)
+        << lines / text_time << " commands/s" << endl;
+   cout << setw (8) << "bytecode" << setw (12)
+        << lines / code_time << " commands/s" << endl;
+   cout << setprecision (2) << "speedup " << text_time / code_time
+        << endl;
+   return EXIT_SUCCESS;
+}
+
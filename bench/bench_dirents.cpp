@@ -0,0 +1,104 @@
+// $Id$
+
+// bench_dirents -
+//    Compares the small-vector dirent_list against the
+//    map<string,inode_ptr> that directories used to hold.  Builds
+//    many small directories, as our generated trees do, then times
+//    lookups and reports heap usage for each representation.  The
+//    dirent_list is timed twice: looking up by string, which goes
+//    through the name_pool, and by an already interned fname.
+//    Usage: bench_dirents [directories] [entries-per-directory]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "dirents.h"
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static size_t heap_in_use() {
+   auto info = mallinfo2();
+   return info.uordblks + info.hblkhd;
+}
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+template <typename container, typename inserter, typename finder>
+static void run (const string& label, size_t ndirs,
+                 const wordvec& names, inserter insert, finder find) {
+   const auto node = inode::make (file_type::PLAIN_TYPE);
+   size_t before = heap_in_use();
+   auto start = bench_clock::now();
+   vector<container> dirs (ndirs);
+   for (auto& dir: dirs) {
+      for (const auto& name: names) insert (dir, name, node);
+   }
+   double build = seconds_since (start);
+   size_t bytes = heap_in_use() - before;
+
+   mt19937 rng (109);
+   uniform_int_distribution<size_t> pick_dir (0, ndirs - 1);
+   uniform_int_distribution<size_t> pick_name (0, names.size() - 1);
+   constexpr size_t LOOKUPS = 4'000'000;
+   size_t found = 0;
+   start = bench_clock::now();
+   for (size_t i = 0; i < LOOKUPS; ++i) {
+      found += find (dirs[pick_dir (rng)], pick_name (rng));
+   }
+   double lookup = seconds_since (start);
+
+   cout << left << setw (12) << label << right
+        << setw (10) << fixed << setprecision (3) << build << " s build"
+        << setw (10) << lookup * 1e9 / LOOKUPS << " ns/lookup"
+        << setw (10) << bytes / ndirs << " B/dir"
+        << "  (" << found << " hits)" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t ndirs = argc > 1 ? strtoul (argv[1], nullptr, 10) : 200'000;
+   size_t nents = argc > 2 ? strtoul (argv[2], nullptr, 10) : 4;
+   wordvec names {".", ".."};
+   for (size_t i = 0; names.size() < nents + 2; ++i) {
+      names.push_back ("part-" + to_string (10000 + i));
+   }
+   cout << ndirs << " directories, " << names.size()
+        << " entries each" << endl;
+
+   vector<fname> interned;
+   for (const auto& name: names) interned.emplace_back (name);
+
+   using dirent_map = map<string,inode_ptr>;
+   run<dirent_map> ("map", ndirs, names,
+      [] (dirent_map& dir, const string& name, const inode_ptr& node) {
+         dir.emplace (name, node);
+      },
+      [&] (const dirent_map& dir, size_t name) {
+         return dir.find (names[name]) != dir.end();
+      });
+   auto insert = [] (dirent_list& dir, const string& name,
+                     const inode_ptr& node) {
+      dir.insert (name, node);
+   };
+   run<dirent_list> ("dirent_list", ndirs, names, insert,
+      [&] (const dirent_list& dir, size_t name) {
+         return dir.find (names[name]) != dir.end();
+      });
+   run<dirent_list> ("fname keys", ndirs, names, insert,
+      [&] (const dirent_list& dir, size_t name) {
+         return dir.find (interned[name]) != dir.end();
+      });
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,88 @@
+// $Id$
+
+// bench_dispatch -
+//    Times looking commands up, as every line of a script does, in
+//    the compile time perfect hash of find_command_fn, and in an
+//    unordered_map from string that throws on a miss, as the table
+//    used to be.  One name in ten is not a command.
+//    Usage: bench_dispatch [lookups]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static const vector<string> names {
+   "cat", "cd", "du", "echo", "exit", "find", "locate", "ls", "lsr",
+   "make", "mkdir", "prompt", "pwd", "restore", "rm", "rmr", "search",
+   "snapshot", "stats",
+};
+
+int main (int argc, char** argv) {
+   size_t lookups = argc > 1 ? strtoul (argv[1], nullptr, 10)
+                             : 10000000;
+   unordered_map<string, command_fn> map;
+   for (const auto& name: names) {
+      command_fn fn = find_command_fn (name);
+      if (fn == nullptr) {
+         cerr << name << ": not found" << endl;
+         return EXIT_FAILURE;
+      }
+      map[name] = fn;
+   }
+   mt19937 random (1);
+   uniform_int_distribution<size_t> pick (0, names.size() * 10 / 9);
+   wordvec input;
+   for (size_t count = 0; count < 4096; ++count) {
+      size_t index = pick (random);
+      input.push_back (index < names.size() ? names[index] : "nosuch");
+   }
+
+   size_t found = 0;
+   auto start = bench_clock::now();
+   for (size_t count = 0; count < lookups; ++count) {
+      const string& name = input[count % input.size()];
+      try {
+         auto result = map.find (name);
+         if (result == map.end()) {
+            throw command_error (name + ": no such function\n");
+         }
+         found += result->second != nullptr;
+      }catch (command_error&) {
+      }
+   }
+   double hashed = seconds_since (start);
+   size_t map_found = found;
+
+   found = 0;
+   start = bench_clock::now();
+   for (size_t count = 0; count < lookups; ++count) {
+      const string& name = input[count % input.size()];
+      found += find_command_fn (name) != nullptr;
+   }
+   double perfect = seconds_since (start);
+
+   cout << lookups << " lookups, " << found << " found";
+   if (found != map_found) cout << " (map found " << map_found << ")";
+   cout << endl << fixed << setprecision (1);
+   cout << setw (14) << "unordered_map" << setw (10)
+        << hashed * 1e9 / lookups << " ns" << endl;
+   cout << setw (14) << "perfect hash" << setw (10)
+        << perfect * 1e9 / lookups << " ns" << endl;
+   cout << setprecision (2) << "speedup " << hashed / perfect << endl;
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+// $Id$
+
+// bench_find -
+//    Times find over a generated tree with one thread and then with
+//    more, doubling up to the number given, and checks that every run
+//    finds the same pathnames in the same order.  The tests are
+//    -type f -name f1*, which most files fail, so the time is mostly
+//    the walk.
+//    Usage: bench_find [max-threads] [fanout] [depth]
+//                      [files-per-directory]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+#include "find.h"
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static size_t build (const inode_ptr& top, size_t fanout, size_t depth,
+                     size_t nfiles) {
+   const wordvec words {"make", "file", "some", "words"};
+   size_t count = 0;
+   for (size_t i = 0; i < nfiles; ++i) {
+      top->mkfile ("f" + to_string (i))->writefile (words);
+      ++count;
+   }
+   if (depth == 0) return count;
+   for (size_t i = 0; i < fanout; ++i) {
+      count += 1 + build (top->mkdir ("d" + to_string (i)), fanout,
+                          depth - 1, nfiles);
+   }
+   return count;
+}
+
+int main (int argc, char** argv) {
+   size_t max_threads = argc > 1 ? strtoul (argv[1], nullptr, 10)
+                                 : thread::hardware_concurrency();
+   size_t fanout = argc > 2 ? strtoul (argv[2], nullptr, 10) : 8;
+   size_t depth = argc > 3 ? strtoul (argv[3], nullptr, 10) : 6;
+   size_t nfiles = argc > 4 ? strtoul (argv[4], nullptr, 10) : 8;
+   inode_state state;
+   size_t nodes = 1 + build (state.get_root(), fanout, depth, nfiles);
+   cout << nodes << " inodes" << endl;
+
+   find_query query;
+   query.type (file_type::PLAIN_TYPE);
+   query.name ("f1*");
+   vector<string> first;
+   double one_thread = 0;
+   cout << setw (8) << "threads" << setw (12) << "seconds"
+        << setw (12) << "ns/inode" << setw (10) << "speedup"
+        << setw (10) << "found" << endl;
+   for (size_t nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+      find_query::threads = nthreads;
+      auto start = bench_clock::now();
+      auto found = query.search (state.get_root().get(), "/");
+      double seconds = seconds_since (start);
+      if (nthreads == 1) {
+         first = found;
+         one_thread = seconds;
+      }
+      cout << setw (8) << nthreads << fixed << setprecision (3)
+           << setw (12) << seconds << setprecision (1) << setw (12)
+           << seconds * 1e9 / nodes << setprecision (2) << setw (10)
+           << one_thread / seconds << setw (10) << found.size();
+      if (found != first) cout << "  (different results)";
+      cout << endl;
+   }
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+// $Id$
+
+// bench_inodes -
+//    Measures mkdir and make throughput through the directory API
+//    with each slab_pool backing.  The heap backing is the old
+//    behaviour of one operator new per inode, per contents object and
+//    per reference count block.  Each backing runs in its own child
+//    process, since the backing cannot change once inodes exist.
+//    The memory still resident once the whole tree has been removed
+//    again is reported too.
+//    Usage: bench_inodes [directories] [files-per-directory]
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+#include "file_sys.h"
+#include "slab.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static size_t resident_bytes() {
+   size_t pages = 0;
+   size_t resident = 0;
+   ifstream statm ("/proc/self/statm");
+   statm >> pages >> resident;
+   return resident * sysconf (_SC_PAGESIZE);
+}
+
+static void run (slab_pool::backing mode, size_t ndirs, size_t nfiles) {
+   slab_pool::set_backing (mode);
+   wordvec dirnames;
+   wordvec filenames;
+   for (size_t i = 0; i < ndirs; ++i) {
+      dirnames.push_back ("d" + to_string (i));
+   }
+   for (size_t i = 0; i < nfiles; ++i) {
+      filenames.push_back ("part-" + to_string (10000 + i));
+   }
+   size_t rss_before = resident_bytes();
+
+   inode_state state;
+   const inode_ptr& root = state.get_root();
+   auto start = bench_clock::now();
+   for (const auto& name: dirnames) root->mkdir (name);
+   double mkdir_time = seconds_since (start);
+
+   start = bench_clock::now();
+   for (const auto& entry: root->get_directory()->get_dirents()) {
+      for (const auto& name: filenames) entry.node->mkfile (name);
+   }
+   double make_time = seconds_since (start);
+   size_t rss = resident_bytes() - rss_before;
+   size_t inodes = ndirs + ndirs * nfiles;
+
+   for (const auto& name: dirnames) root->get_directory()->remove (name);
+   size_t kept = resident_bytes() - rss_before;
+
+   cout << left << setw (12) << slab_pool::get_backing() << right
+        << fixed << setprecision (0)
+        << setw (12) << ndirs / mkdir_time << " mkdir/s"
+        << setw (12) << ndirs * nfiles / make_time << " make/s"
+        << setw (8) << rss / inodes << " B/inode"
+        << setw (8) << kept / (1 << 20) << " MiB kept after rm" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t ndirs = argc > 1 ? strtoul (argv[1], nullptr, 10) : 100'000;
+   size_t nfiles = argc > 2 ? strtoul (argv[2], nullptr, 10) : 10;
+   cout << ndirs << " directories, " << nfiles
+        << " files each" << endl;
+   for (auto mode: {slab_pool::backing::HEAP, slab_pool::backing::SLAB,
+                    slab_pool::backing::HUGE_PAGES}) {
+      pid_t child = fork();
+      if (child == 0) {
+         run (mode, ndirs, nfiles);
+         _exit (EXIT_SUCCESS);
+      }
+      waitpid (child, nullptr, 0);
+   }
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,98 @@
+// $Id$
+
+// bench_numbers -
+//    Measures inode number allocation from several threads at once,
+//    each allocating a block of numbers and freeing them again, as a
+//    thread creating and removing files would.  The same work is
+//    timed against one free list behind one lock, for comparison,
+//    and the number of fresh numbers issued shows how well freed
+//    ones are reused.
+//    Usage: bench_numbers [max-threads] [operations-per-thread]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "numbers.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+// locked_numbers -
+//    The simple way: a counter and a free list under a single lock.
+
+class locked_numbers {
+   private:
+      mutex lock;
+      inode_nr_t next {inode_numbers::ROOT + 1};
+      vector<inode_nr_t> free;
+   public:
+      inode_nr_t allocate() {
+         lock_guard<mutex> guard (lock);
+         if (free.empty()) return next++;
+         inode_nr_t number = free.back();
+         free.pop_back();
+         return number;
+      }
+      void release (inode_nr_t number) {
+         lock_guard<mutex> guard (lock);
+         free.push_back (number);
+      }
+};
+
+constexpr size_t BLOCK = 1000;
+
+template <typename allocate_fn, typename release_fn>
+static double run (size_t nthreads, size_t ops, allocate_fn allocate,
+                   release_fn release) {
+   auto start = bench_clock::now();
+   vector<thread> threads;
+   for (size_t t = 0; t < nthreads; ++t) {
+      threads.emplace_back ([=] {
+         vector<inode_nr_t> held (BLOCK);
+         for (size_t done = 0; done < ops; done += BLOCK) {
+            for (auto& number: held) number = allocate();
+            for (auto number: held) release (number);
+         }
+      });
+   }
+   for (auto& worker: threads) worker.join();
+   return seconds_since (start);
+}
+
+int main (int argc, char** argv) {
+   size_t max_threads = argc > 1 ? strtoul (argv[1], nullptr, 10)
+                                 : thread::hardware_concurrency();
+   size_t ops = argc > 2 ? strtoul (argv[2], nullptr, 10) : 10'000'000;
+   cout << setw (8) << "threads" << setw (16) << "batched Mop/s"
+        << setw (16) << "locked Mop/s" << setw (12) << "issued"
+        << endl;
+   for (size_t nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+      double batched = run (nthreads, ops,
+                            [] { return inode_numbers::allocate(); },
+                            [] (inode_nr_t nr) {
+                               inode_numbers::release (nr);
+                            });
+      locked_numbers simple;
+      double locked = run (nthreads, ops,
+                           [&simple] { return simple.allocate(); },
+                           [&simple] (inode_nr_t nr) {
+                              simple.release (nr);
+                           });
+      double total = 2.0 * nthreads * ops / 1e6;
+      cout << setw (8) << nthreads << fixed << setprecision (1)
+           << setw (16) << total / batched
+           << setw (16) << total / locked
+           << setw (12) << inode_numbers::stats().issued << endl;
+   }
+   return EXIT_SUCCESS;
+}
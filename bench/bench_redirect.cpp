@@ -0,0 +1,126 @@
+// $Id$
+
+// bench_redirect -
+//    Times lsr / redirected into a file in the tree, against lsr with
+//    its output thrown away, and against the round trip that was the
+//    only way before: gathering the output of lsr into a string,
+//    splitting it into words, and writing them with writefile.  The
+//    fastest of several runs of each is kept.  The two files written
+//    are checked to be the same.
+//    Usage: bench_redirect [fanout] [depth] [files-per-directory]
+//                          [runs]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "redirect.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+class null_buffer: public streambuf {
+   protected:
+      int overflow (int c) override { return c; }
+      streamsize xsputn (const char*, streamsize count) override {
+         return count;
+      }
+};
+
+static void build (const inode_ptr& top, size_t fanout, size_t depth,
+                   size_t nfiles) {
+   const wordvec words {"make", "file", "some", "words"};
+   for (size_t i = 0; i < nfiles; ++i) {
+      top->mkfile ("f" + to_string (i))->writefile (words);
+   }
+   if (depth == 0) return;
+   for (size_t i = 0; i < fanout; ++i) {
+      build (top->mkdir ("d" + to_string (i)), fanout, depth - 1, nfiles);
+   }
+}
+
+static double discarded (inode_state& state) {
+   null_buffer discard;
+   streambuf* saved = cout.rdbuf (&discard);
+   auto start = bench_clock::now();
+   fn_lsr (state, {"lsr", "/top"});
+   double seconds = seconds_since (start);
+   cout.rdbuf (saved);
+   return seconds;
+}
+
+static double redirected (inode_state& state) {
+   auto start = bench_clock::now();
+   redirect::run (state, {"lsr", "/top", ">", "/redirected"});
+   return seconds_since (start);
+}
+
+static double round_trip (inode_state& state) {
+   auto start = bench_clock::now();
+   ostringstream gathered;
+   streambuf* saved = cout.rdbuf (gathered.rdbuf());
+   fn_lsr (state, {"lsr", "/top"});
+   cout.rdbuf (saved);
+   wordvec words {"make", "/round_trip"};
+   for (auto& word: split (gathered.str(), " \t\n")) {
+      words.push_back (move (word));
+   }
+   fn_rm (state, {"rm", "/round_trip"});
+   fn_make (state, words);
+   return seconds_since (start);
+}
+
+static void report (const string& label, double seconds, size_t bytes) {
+   cout << left << setw (12) << label << right << fixed
+        << setprecision (4) << setw (10) << seconds << " s"
+        << setprecision (1) << setw (10) << bytes / seconds / 1e6
+        << " MB/s" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t fanout = argc > 1 ? strtoul (argv[1], nullptr, 10) : 8;
+   size_t depth = argc > 2 ? strtoul (argv[2], nullptr, 10) : 4;
+   size_t nfiles = argc > 3 ? strtoul (argv[3], nullptr, 10) : 8;
+   size_t runs = argc > 4 ? strtoul (argv[4], nullptr, 10) : 5;
+   inode_state state;
+   build (state.get_root()->mkdir ("top"), fanout, depth, nfiles);
+   state.get_root()->mkfile ("round_trip");
+
+   double discard_time = 1e9;
+   double redirect_time = 1e9;
+   double round_time = 1e9;
+   for (size_t count = 0; count < runs; ++count) {
+      discard_time = min (discard_time, discarded (state));
+      redirect_time = min (redirect_time, redirected (state));
+      round_time = min (round_time, round_trip (state));
+   }
+
+   const string& written =
+         state.get_root()->get_directory()->lookup ("redirected")
+         ->readfile();
+   const string& expected =
+         state.get_root()->get_directory()->lookup ("round_trip")
+         ->readfile();
+   size_t bytes = written.size();
+   cout << bytes << " bytes of listing, "
+        << (written == expected ? "files match" : "FILES DIFFER") << endl;
+   report ("discarded", discard_time, bytes);
+   report ("redirected", redirect_time, bytes);
+   report ("round trip", round_time, bytes);
+   cout << setprecision (2) << "speedup " << round_time / redirect_time
+        << endl;
+   return written == expected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
@@ -0,0 +1,84 @@
+// $Id$
+
+// bench_resolve -
+//    Times path lookups in a generated tree, for paths that exist
+//    and for paths whose last name is missing: the old way, splitting
+//    the path into strings and looking each one up; walking it in
+//    place with directory::resolve; and through the dentry_cache.
+//    Usage: bench_resolve [depth] [entries-per-directory] [lookups]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#include "dcache.h"
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static inode_ptr split_lookup (const inode_ptr& start,
+                               const string& path) {
+   inode_ptr node = start;
+   for (const auto& name: split (path, "/")) {
+      auto dir = node->get_directory();
+      if (dir == nullptr) return nullptr;
+      node = dir->lookup (name);
+      if (node == nullptr) return nullptr;
+   }
+   return node;
+}
+
+template <typename lookup_fn>
+static void report (const string& label, size_t count, lookup_fn lookup) {
+   size_t found = 0;
+   auto start = bench_clock::now();
+   for (size_t i = 0; i < count; ++i) found += lookup() != nullptr;
+   double seconds = seconds_since (start);
+   cout << left << setw (24) << label << right << fixed
+        << setprecision (1) << setw (10) << seconds * 1e9 / count
+        << " ns/lookup" << setw (10) << found << " found" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t depth = argc > 1 ? strtoul (argv[1], nullptr, 10) : 12;
+   size_t width = argc > 2 ? strtoul (argv[2], nullptr, 10) : 64;
+   size_t count = argc > 3 ? strtoul (argv[3], nullptr, 10)
+                           : 1'000'000;
+   inode_state state;
+   const inode_ptr& root = state.get_root();
+   inode_ptr dir = root;
+   string path;
+   for (size_t level = 0; level < depth; ++level) {
+      for (size_t i = 1; i < width; ++i) {
+         dir->mkfile ("file-" + to_string (i));
+      }
+      dir = dir->mkdir ("directory-" + to_string (level));
+      path += (level == 0 ? "" : "/") + dir->get_directory()->get_name();
+   }
+   dir->mkfile ("leaf");
+   string present = path + "/leaf";
+   string missing = path + "/absent";
+   cout << depth << " levels of " << width << " entries" << endl;
+
+   for (const auto& probe: {present, missing}) {
+      string what = probe == present ? "found, " : "missing, ";
+      report (what + "split", count,
+              [&] { return split_lookup (root, probe); });
+      report (what + "in place", count, [&] {
+         return root->get_directory()->resolve (probe).node;
+      });
+      report (what + "cached", count, [&] {
+         return dentry_cache::resolve (root, probe).node;
+      });
+   }
+   cout << dentry_cache::stats() << endl;
+   return EXIT_SUCCESS;
+}
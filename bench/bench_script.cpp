@@ -0,0 +1,116 @@
+// $Id$
+
+// bench_script -
+//    Writes a script of cheap commands and comments, then times
+//    running it the way main reads stdin, a line at a time through
+//    getline and split, and in batch mode, through a mapping and
+//    views, and prints the commands per second of each.  Output goes
+//    to a stream that discards it, so what is timed is reading,
+//    parsing and dispatch, plus the commands themselves, which are
+//    the same for both.
+//    Usage: bench_script [lines] [script-file]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "script.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+// discard -
+//    A stream buffer that throws away whatever is written to it.
+
+class discard: public streambuf {
+   protected:
+      int overflow (int letter) override { return letter; }
+      streamsize xsputn (const char*, streamsize count) override {
+         return count;
+      }
+};
+
+static void write_script (const string& filename, size_t lines) {
+   static const char* const commands[] {
+      "echo the quick brown fox jumps over the lazy dog",
+      "cd d",
+      "pwd",
+      "# a comment, which is skipped",
+      "cd /",
+      "ls d",
+      "",
+      "cat d/f",
+   };
+   ofstream out (filename);
+   out << "mkdir d" << "\n" << "make d/f some words" << "\n";
+   for (size_t line = 2; line < lines; ++line) {
+      out << commands[line % size (commands)] << "\n";
+   }
+}
+
+// run_stream -
+//    The loop in main, without the prompt and the echo.
+
+static void run_stream (inode_state& state, const string& filename) {
+   ifstream in (filename);
+   string line;
+   while (getline (in, line)) {
+      wordvec words = split (line, " \t");
+      if (words.size() == 0 or words[0].at(0) == '#') continue;
+      command_fn fn = find_command_fn (words.at(0));
+      if (fn == nullptr) {
+         no_such_command (words.at(0));
+         continue;
+      }
+      try {
+         fn (state, words);
+      }catch (command_error& error) {
+         complain() << error.what() << endl;
+      }
+   }
+}
+
+int main (int argc, char** argv) {
+   size_t lines = argc > 1 ? strtoul (argv[1], nullptr, 10) : 10000000;
+   string filename = argc > 2 ? argv[2] : "/tmp/bench_script.ysh";
+   write_script (filename, lines);
+   discard nowhere;
+   streambuf* saved = cout.rdbuf (&nowhere);
+
+   auto start = bench_clock::now();
+   {
+      inode_state state;
+      run_stream (state, filename);
+   }
+   double stream = seconds_since (start);
+   start = bench_clock::now();
+   {
+      inode_state state;
+      script (filename).run (state);
+   }
+   double batch = seconds_since (start);
+
+   cout.rdbuf (saved);
+   remove (filename.c_str());
+   cout << right << lines << " lines" << endl;
+   cout << fixed << setprecision (0);
+   cout << setw (8) << "getline" << setw (12) << lines / stream
+        << " lines/s" << endl;
+   cout << setw (8) << "mapped" << setw (12) << lines / batch
+        << " lines/s" << endl;
+   cout << setprecision (2) << "speedup " << stream / batch << endl;
+   return EXIT_SUCCESS;
+}
+
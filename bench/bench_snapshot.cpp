@@ -0,0 +1,111 @@
+// $Id$
+
+// bench_snapshot -
+//    Times taking snapshots of a generated tree, which should cost
+//    the same however big the tree is, and the cost of making files
+//    in the tree's leaf directories: with no snapshot, right after a
+//    single snapshot, and with a fresh snapshot before every make,
+//    so that each one copies the whole path down from the root.
+//    Usage: bench_snapshot [fanout] [depth] [files-per-directory]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static size_t build (const inode_ptr& top, wordvec& path,
+                     vector<wordvec>& leaves, size_t fanout,
+                     size_t depth, size_t nfiles) {
+   const wordvec words {"make", "file", "some", "words"};
+   size_t count = 0;
+   for (size_t i = 0; i < nfiles; ++i) {
+      top->mkfile ("f" + to_string (i))->writefile (words);
+      ++count;
+   }
+   if (depth == 0) {
+      leaves.push_back (path);
+      return count;
+   }
+   for (size_t i = 0; i < fanout; ++i) {
+      path.push_back ("d" + to_string (i));
+      count += 1 + build (top->mkdir (path.back()), path, leaves,
+                          fanout, depth - 1, nfiles);
+      path.pop_back();
+   }
+   return count;
+}
+
+// resolve -
+//    Walks a path down from the root, as the commands do, since any
+//    inode held from before a change may since have been copied.
+
+static inode_ptr resolve (const inode_state& state, const wordvec& path) {
+   inode_ptr node = state.get_root();
+   for (const auto& name: path) {
+      node = node->get_directory()->lookup (name);
+   }
+   return node;
+}
+
+static void report (const string& label, double seconds, size_t ops) {
+   cout << left << setw (16) << label << right << fixed
+        << setprecision (3) << setw (10) << seconds << " s"
+        << setprecision (1) << setw (12) << seconds * 1e9 / ops
+        << " ns/op" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t fanout = argc > 1 ? strtoul (argv[1], nullptr, 10) : 8;
+   size_t depth = argc > 2 ? strtoul (argv[2], nullptr, 10) : 6;
+   size_t nfiles = argc > 3 ? strtoul (argv[3], nullptr, 10) : 4;
+   inode_state state;
+   wordvec path;
+   vector<wordvec> leaves;
+   size_t nodes = 1 + build (state.get_root(), path, leaves, fanout,
+                             depth, nfiles);
+   shuffle (leaves.begin(), leaves.end(), mt19937 {42});
+   cout << nodes << " inodes, " << leaves.size() << " leaf directories "
+        << depth << " deep" << endl;
+
+   constexpr size_t SNAPSHOTS = 1'000'000;
+   auto start = bench_clock::now();
+   for (size_t i = 0; i < SNAPSHOTS; ++i) {
+      state.snapshot ("s" + to_string (i % 8));
+   }
+   report ("snapshot", seconds_since (start), SNAPSHOTS);
+
+   const string names[] {"plain", "after snapshot", "every snapshot"};
+   for (size_t round = 0; round < 3; ++round) {
+      if (round == 0) {
+         // Nothing is frozen once the tree is replaced by a copy of
+         // itself, so this is the cost without copy on write.
+         for (const auto& leaf: leaves) {
+            state.writable (resolve (state, leaf));
+         }
+      }
+      if (round == 1) state.snapshot ("s0");
+      string filename = "new" + to_string (round);
+      start = bench_clock::now();
+      for (const auto& leaf: leaves) {
+         if (round == 2) state.snapshot ("s0");
+         state.writable (resolve (state, leaf))->mkfile (filename);
+      }
+      report (names[round], seconds_since (start), leaves.size());
+   }
+   cout << inode_table::size() << " live inodes" << endl;
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+// $Id$
+
+// bench_soak -
+//    Repeatedly builds a subtree and removes it again, reporting the
+//    resident set size and live inode count as it goes.  With the
+//    old strong dot and dotdot links nothing was ever freed and RSS
+//    grew every round; now it should level off after the first one.
+//    Each round also builds one deep chain of directories, whose
+//    removal must not recurse once per level.  Building the chain is
+//    quadratic in its depth, since every mkdir updates the totals of
+//    all its ancestors.
+//    Usage: bench_soak [rounds] [directories-per-round] [chain-depth]
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static size_t resident_kb() {
+   size_t pages = 0;
+   size_t resident = 0;
+   ifstream statm ("/proc/self/statm");
+   statm >> pages >> resident;
+   return resident * sysconf (_SC_PAGESIZE) / 1024;
+}
+
+static void build (const inode_ptr& top, size_t ndirs, size_t depth) {
+   const wordvec words {"make", "file", "some", "words", "of", "data"};
+   for (size_t i = 0; i < ndirs; ++i) {
+      inode_ptr dir = top->mkdir ("d" + to_string (i));
+      for (size_t j = 0; j < 4; ++j) {
+         dir->mkfile ("f" + to_string (j))->writefile (words);
+      }
+   }
+   inode_ptr link = top;
+   for (size_t level = 0; level < depth; ++level) {
+      link = link->mkdir ("deep");
+   }
+}
+
+int main (int argc, char** argv) {
+   size_t rounds = argc > 1 ? strtoul (argv[1], nullptr, 10) : 50;
+   size_t ndirs = argc > 2 ? strtoul (argv[2], nullptr, 10) : 20'000;
+   size_t depth = argc > 3 ? strtoul (argv[3], nullptr, 10) : 20'000;
+   inode_state state;
+   const inode_ptr& root = state.get_root();
+   cout << setw (6) << "round" << setw (12) << "build s"
+        << setw (12) << "remove s" << setw (12) << "RSS KiB"
+        << setw (12) << "inodes" << endl;
+   for (size_t round = 1; round <= rounds; ++round) {
+      auto start = bench_clock::now();
+      build (root->mkdir ("work"), ndirs, depth);
+      double build_time = seconds_since (start);
+      start = bench_clock::now();
+      root->remove ("work");
+      double remove_time = seconds_since (start);
+      cout << setw (6) << round << fixed << setprecision (3)
+           << setw (12) << build_time << setw (12) << remove_time
+           << setw (12) << resident_kb()
+           << setw (12) << inode_table::size() << endl;
+   }
+   return EXIT_SUCCESS;
+}
+
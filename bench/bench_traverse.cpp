@@ -0,0 +1,97 @@
+// $Id$
+
+// bench_traverse -
+//    Times whole-tree walks over a generated tree: a bare walk that
+//    touches each inode's type and size, lsr with its output thrown
+//    away, and rmr.  Reported per inode visited.
+//    Usage: bench_traverse [fanout] [depth] [files-per-directory]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+class null_buffer: public streambuf {
+   protected:
+      int overflow (int c) override { return c; }
+      streamsize xsputn (const char*, streamsize count) override {
+         return count;
+      }
+};
+
+static size_t build (const inode_ptr& top, size_t fanout, size_t depth,
+                     size_t nfiles) {
+   const wordvec words {"make", "file", "some", "words"};
+   size_t count = 0;
+   for (size_t i = 0; i < nfiles; ++i) {
+      top->mkfile ("f" + to_string (i))->writefile (words);
+      ++count;
+   }
+   if (depth == 0) return count;
+   for (size_t i = 0; i < fanout; ++i) {
+      count += 1 + build (top->mkdir ("d" + to_string (i)), fanout,
+                          depth - 1, nfiles);
+   }
+   return count;
+}
+
+static size_t walk (const inode* node) {
+   size_t total = node->size();
+   node->get_directory()->for_each_entry (
+      [&total] (const string& name, const inode* child) {
+         if (child->get_type() == file_type::DIRECTORY_TYPE) {
+            if (name != "." and name != "..") total += walk (child);
+         }else {
+            total += child->size();
+         }
+      });
+   return total;
+}
+
+static void report (const string& label, double seconds, size_t nodes) {
+   cout << left << setw (8) << label << right << fixed
+        << setprecision (3) << setw (10) << seconds << " s"
+        << setprecision (1) << setw (10) << seconds * 1e9 / nodes
+        << " ns/inode" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t fanout = argc > 1 ? strtoul (argv[1], nullptr, 10) : 8;
+   size_t depth = argc > 2 ? strtoul (argv[2], nullptr, 10) : 5;
+   size_t nfiles = argc > 3 ? strtoul (argv[3], nullptr, 10) : 4;
+   inode_state state;
+   size_t nodes = 1 + build (state.get_root(), fanout, depth, nfiles);
+   cout << nodes << " inodes" << endl;
+
+   auto start = bench_clock::now();
+   size_t total = walk (state.get_root().get());
+   report ("walk", seconds_since (start), nodes);
+
+   null_buffer discard;
+   streambuf* saved = cout.rdbuf (&discard);
+   start = bench_clock::now();
+   fn_lsr (state, {"lsr", "/"});
+   double lsr_time = seconds_since (start);
+   cout.rdbuf (saved);
+   report ("lsr", lsr_time, nodes);
+
+   start = bench_clock::now();
+   fn_rmr (state, {"rmr"});
+   report ("rmr", seconds_since (start), nodes);
+   cout << "(checksum " << total << ")" << endl;
+   return EXIT_SUCCESS;
+}
+
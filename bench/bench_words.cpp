@@ -0,0 +1,162 @@
+// $Id$
+
+// bench_words -
+//    Builds a tree of files whose words are drawn from a vocabulary
+//    with a Zipf distribution, as natural text roughly is, and times
+//    building the word index over it, what the postings cost in
+//    memory, and searches for rare and common words, alone and
+//    together, against reading every file.  Then times making more
+//    files with the index off and on, to show what keeping it up to
+//    date costs each writefile.
+//    Usage: bench_words [files] [words-per-file] [vocabulary]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+#include "file_sys.h"
+#include "words.h"
+
+using bench_clock = chrono::steady_clock;
+
+static double seconds_since (bench_clock::time_point start) {
+   return chrono::duration<double> (bench_clock::now() - start).count();
+}
+
+static constexpr size_t FILES_PER_DIR = 100;
+
+static string word_of (size_t rank) { return "w" + to_string (rank); }
+
+// make_files -
+//    Makes files in directories of FILES_PER_DIR under top, each
+//    with the given number of words, numbering them from first.
+
+static void make_files (const inode_ptr& top, size_t first,
+                        size_t count, size_t nwords,
+                        discrete_distribution<size_t>& zipf,
+                        mt19937& random) {
+   inode_ptr dir;
+   wordvec words {"make", "file"};
+   for (size_t i = first; i < first + count; ++i) {
+      if (dir == nullptr or i % FILES_PER_DIR == 0) {
+         string name = "d" + to_string (i / FILES_PER_DIR);
+         dir = top->get_directory()->lookup (name);
+         if (dir == nullptr) dir = top->mkdir (name);
+      }
+      words.resize (2);
+      for (size_t w = 0; w < nwords; ++w) {
+         words.push_back (word_of (zipf (random)));
+      }
+      dir->mkfile ("f" + to_string (i))->writefile (words);
+   }
+}
+
+// scan -
+//    The number of files containing all the words, found by reading
+//    every file, as searching would without the index.
+
+static size_t scan (const inode* node, const vector<string_view>& words) {
+   directory* dir = node->get_directory();
+   if (dir == nullptr) {
+      const plain_file* file = node->get_file();
+      for (string_view wanted: words) {
+         bool found = false;
+         for (size_t w = 0; w < file->word_count() and not found; ++w) {
+            found = file->word (w) == wanted;
+         }
+         if (not found) return 0;
+      }
+      return 1;
+   }
+   size_t count = 0;
+   dir->for_each_prefixed ("", [&] (const string&, const inode* entry) {
+      count += scan (entry, words);
+   });
+   return count;
+}
+
+int main (int argc, char** argv) {
+   size_t nfiles = argc > 1 ? strtoul (argv[1], nullptr, 10) : 20000;
+   size_t nwords = argc > 2 ? strtoul (argv[2], nullptr, 10) : 100;
+   size_t vocabulary = argc > 3 ? strtoul (argv[3], nullptr, 10)
+                                : 20000;
+   vector<double> weights;
+   for (size_t rank = 1; rank <= vocabulary; ++rank) {
+      weights.push_back (1.0 / rank);
+   }
+   discrete_distribution<size_t> zipf (weights.begin(), weights.end());
+   mt19937 random (1);
+   inode_state state;
+   make_files (state.get_root(), 0, nfiles, nwords, zipf, random);
+   const auto& totals = state.get_root()->get_directory()->get_totals();
+   cout << nfiles << " files of " << nwords << " words, "
+        << totals.bytes << " bytes of text" << endl;
+
+   auto start = bench_clock::now();
+   word_index::build (state.get_root().get());
+   double seconds = seconds_since (start);
+   auto stats = word_index::stats();
+   cout << fixed << setprecision (3) << "build: " << seconds
+        << " s, " << setprecision (1) << seconds * 1e9 / stats.postings
+        << " ns/posting" << endl;
+   cout << stats << endl;
+   cout << setprecision (2) << "postings: "
+        << double (stats.bytes) / stats.postings << " bytes each, "
+        << double (stats.bytes) / totals.bytes << " of the text"
+        << endl;
+
+   const vector<vector<string_view>> queries {
+      {"w1"}, {"w100"}, {"w10000"}, {"w1", "w2"}, {"w1", "w10000"},
+      {"w10", "w20", "w30"},
+   };
+   vector<vector<string>> texts;
+   cout << setw (24) << "query" << setw (10) << "found"
+        << setw (14) << "index us" << setw (14) << "scan us"
+        << setw (10) << "speedup" << endl;
+   for (const auto& query: queries) {
+      string label;
+      for (string_view word: query) {
+         if (not label.empty()) label += ' ';
+         label += word;
+      }
+      size_t repeats = 20;
+      size_t found = 0;
+      start = bench_clock::now();
+      for (size_t rep = 0; rep < repeats; ++rep) {
+         found = word_index::search (query).size();
+      }
+      double indexed = seconds_since (start) / repeats;
+      start = bench_clock::now();
+      size_t scanned = scan (state.get_root().get(), query);
+      double read_all = seconds_since (start);
+      cout << setw (24) << label << setw (10) << found
+           << setprecision (1) << setw (14) << indexed * 1e6
+           << setw (14) << read_all * 1e6 << setw (10)
+           << read_all / indexed;
+      if (found != scanned) cout << "  (scan found " << scanned << ")";
+      cout << endl;
+   }
+
+   size_t more = max<size_t> (1, nfiles / 10);
+   word_index::clear();
+   start = bench_clock::now();
+   make_files (state.get_root(), nfiles, more, nwords, zipf, random);
+   double without = seconds_since (start);
+   word_index::build (state.get_root().get());
+   start = bench_clock::now();
+   make_files (state.get_root(), nfiles + more, more, nwords, zipf,
+               random);
+   double with = seconds_since (start);
+   cout << setprecision (1) << "make " << more << " files: "
+        << without * 1e6 / more << " us each without the index, "
+        << with * 1e6 / more << " us with it" << endl;
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,233 @@
+// $Id$
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "bytecode.h"
+#include "commands.h"
+#include "dcache.h"
+#include "debug.h"
+#include "pipeline.h"
+#include "redirect.h"
+
+// put -
+//    Appends a variable length integer.
+
+static void put (string& out, uint64_t value) {
+   while (value >= 0x80) {
+      out += static_cast<char> (value | 0x80);
+      value >>= 7;
+   }
+   out += static_cast<char> (value);
+}
+
+// decoder -
+//    Reads numbers and byte strings back, checking every one against
+//    the end of the contents.
+
+class decoder {
+   private:
+      const char* next;
+      const char* end;
+      [[noreturn]] static void malformed() {
+         throw script_error ("malformed bytecode");
+      }
+   public:
+      explicit decoder (string_view contents):
+               next (contents.data()),
+               end (contents.data() + contents.size()) {}
+      bool done() const { return next == end; }
+      size_t left() const { return end - next; }
+      uint64_t number() {
+         uint64_t value = 0;
+         for (int shift = 0; shift < 64; shift += 7) {
+            if (next == end) malformed();
+            uint8_t byte = *next++;
+            value |= static_cast<uint64_t> (byte & 0x7F) << shift;
+            if (byte < 0x80) return value;
+         }
+         malformed();
+      }
+      string_view bytes (uint64_t length) {
+         if (length > left()) malformed();
+         string_view result (next, length);
+         next += length;
+         return result;
+      }
+      uint64_t index (uint64_t limit) {
+         uint64_t value = number();
+         if (value >= limit) malformed();
+         return value;
+      }
+};
+
+// interned -
+//    Names in the order they were first seen, each with its index.
+
+struct interned {
+   unordered_map<string, uint64_t> index;
+   vector<const string*> names;
+   uint64_t operator() (string_view name) {
+      auto found = index.emplace (string (name), names.size());
+      if (found.second) names.push_back (&found.first->first);
+      return found.first->second;
+   }
+   void write (string& out) const {
+      put (out, names.size());
+      for (const string* name: names) {
+         put (out, name->size());
+         out += *name;
+      }
+   }
+};
+
+// prefix_length -
+//    The length of a path up to the slash before its last name, or
+//    zero if it has no slash there.
+
+static size_t prefix_length (string_view path) {
+   size_t end = path.find_last_not_of ('/');
+   if (end == string_view::npos) return 0;
+   size_t slash = path.find_last_of ('/', end);
+   return slash == string_view::npos ? 0 : slash + 1;
+}
+
+// anchoring -
+//    Points the dentry cache at an anchor, or at none, for as long as
+//    it lives.
+
+struct anchoring {
+   explicit anchoring (dentry_cache::anchor* where) {
+      dentry_cache::use (where);
+   }
+   ~anchoring() { dentry_cache::use (nullptr); }
+};
+
+bool bytecode::is_compound (string_view word) {
+   return word.find ('|') != string::npos or word == ">" or word == ">>";
+}
+
+bool bytecode::is_bytecode (string_view contents) {
+   return contents.substr (0, MAGIC.size()) == MAGIC;
+}
+
+void bytecode::compile (script& input, const string& filename) {
+   interned commands;
+   interned operands;
+   string code;
+   vector<string_view> words;
+   size_t lines = 0;
+   while (input.next_line (words)) {
+      if (words.empty() or words[0][0] == '#') continue;
+      ++lines;
+      bool compound = any_of (words.begin(), words.end(), is_compound);
+      if (compound) {
+         put (code, commands (COMPOUND));
+         put (code, words.size());
+      }else {
+         put (code, commands (words[0]));
+         put (code, words.size() - 1);
+      }
+      size_t literals = compound ? words.size()
+                      : words[0] == "make" ? 2
+                      : words[0] == "echo" ? 1 : words.size();
+      for (size_t index = compound ? 0 : 1; index < words.size();
+           ++index) {
+         if (index >= literals) {
+            put (code, words[index].size() * 2 + 1);
+            code.append (words[index]);
+         }else {
+            put (code, operands (words[index]) * 2);
+         }
+      }
+   }
+
+   string header (MAGIC);
+   commands.write (header);
+   operands.write (header);
+   ofstream out (filename, ios::binary);
+   out << header << code;
+   out.close();
+   if (not out) throw script_error (filename + ": " + strerror (errno));
+   DEBUGF ('u', filename << ": " << lines << " instructions, "
+           << operands.names.size() << " operands, "
+           << header.size() + code.size() << " bytes");
+}
+
+void bytecode::run (string_view contents, inode_state& state) {
+   decoder in (contents.substr (MAGIC.size()));
+   vector<string_view> names;
+   vector<command_fn> fns;
+   for (uint64_t count = in.index (in.left() + 1); count > 0; --count) {
+      names.push_back (in.bytes (in.number()));
+      fns.push_back (find_command_fn (names.back()));
+   }
+   vector<string_view> operands;
+   for (uint64_t count = in.index (in.left() + 1); count > 0; --count) {
+      operands.push_back (in.bytes (in.number()));
+   }
+
+   // Operands that share the directory their last name is in share
+   // an anchor for it.
+   static constexpr size_t NONE = SIZE_MAX;
+   unordered_map<string_view, size_t> prefixes;
+   vector<size_t> anchor_of (operands.size(), NONE);
+   vector<dentry_cache::anchor> anchors;
+   for (size_t index = 0; index < operands.size(); ++index) {
+      string_view prefix = operands[index].substr (0,
+                           prefix_length (operands[index]));
+      if (prefix.find_first_not_of ('/') == string_view::npos) continue;
+      auto found = prefixes.emplace (prefix, anchors.size());
+      if (found.second) {
+         anchors.emplace_back();
+         anchors.back().prefix = prefix;
+      }
+      anchor_of[index] = found.first->second;
+   }
+
+   wordvec words;
+   while (not in.done()) {
+      uint64_t opcode = in.index (names.size());
+      words.resize (in.index (in.left() + 1) + 1);
+      words[0].assign (names[opcode]);
+      size_t anchor = NONE;
+      for (size_t index = 1; index < words.size(); ++index) {
+         uint64_t tag = in.number();
+         if (tag & 1) {
+            words[index].assign (in.bytes (tag >> 1));
+         }else if ((tag >> 1) < operands.size()) {
+            words[index].assign (operands[tag >> 1]);
+            if (index == 1) anchor = anchor_of[tag >> 1];
+         }else {
+            throw script_error ("malformed bytecode");
+         }
+      }
+      bool compound = names[opcode] == COMPOUND;
+      if (fns[opcode] == nullptr and not compound) {
+         no_such_command (names[opcode]);
+         continue;
+      }
+      try {
+         anchoring held (anchor == NONE ? nullptr : &anchors[anchor]);
+         if (not compound) {
+            fns[opcode] (state, words);
+         }else {
+            wordvec line (words.begin() + 1, words.end());
+            if (redirect::is_redirected (line)) {
+               redirect::run (state, line);
+            }else {
+               pipeline::run (state, line);
+            }
+         }
+      }catch (command_error& error) {
+         complain() << error.what() << endl;
+      }
+   }
+}
+
@@ -0,0 +1,71 @@
+// $Id$
+
+// bytecode -
+//    Scripts compiled ahead of time into a compact binary form, which
+//    replays without tokenizing lines or looking commands up by name.
+
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+
+#include <string>
+#include <string_view>
+using namespace std;
+
+#include "file_sys.h"
+#include "script.h"
+
+// class bytecode -
+//    A compiled script is laid out as follows, every number being a
+//    variable length integer of seven bits to a byte, low bits first:
+//       MAGIC
+//       the number of commands, then each command's name
+//       the number of operands, then each operand
+//       the instructions, up to the end of the file
+//    A name or operand is its length and then its bytes.  An
+//    instruction is an opcode, which indexes the command names, the
+//    number of operands, and then each operand: either twice its index
+//    in the operand table, for a name that is interned, or one more
+//    than twice its length followed by its bytes, for a literal.
+//    Pathnames are interned, so each distinct one is stored once; the
+//    words that make writes into a file and that echo prints are
+//    literals, since they are rarely repeated.  A compound line, one
+//    that is a pipeline or is redirected, is compiled as the command
+//    COMPOUND, with all of its words as operands, and run by
+//    pipeline::run or redirect::run.  Blank lines and
+//    comments are dropped.  Opcodes number the commands the script
+//    uses, not the shell's, so a compiled script does not depend on
+//    the build that made it.
+// is_compound -
+//    Whether a word makes its line compound: it has a | in it, or it
+//    is > or >>.
+// is_bytecode -
+//    Whether the contents of a file start with MAGIC.
+// compile -
+//    Compiles the script and writes the result to the file, or
+//    throws script_error if it cannot be written.
+// run -
+//    Runs compiled contents, as script::run runs text.  Each command
+//    name is looked up once, when the tables are read, and an
+//    instruction's words are copied into one wordvec kept from one
+//    instruction to the next.  The directory that holds the last name
+//    of each interned operand is found once, when an instruction
+//    first names it, and kept for the run as a dentry_cache::anchor,
+//    shared by every operand with the same directory.  An instruction
+//    whose first operand is interned takes that operand from its
+//    anchor, looking up only the last name.  The anchor is found again
+//    only if a directory on the way to it loses an entry or moves,
+//    not when make or mkdir adds one.  Throws script_error if the
+//    contents are malformed.
+
+class bytecode {
+   public:
+      static constexpr string_view MAGIC {"YBC\1", 4};
+      static constexpr string_view COMPOUND {"|"};
+      static bool is_compound (string_view word);
+      static bool is_bytecode (string_view contents);
+      static void compile (script& input, const string& filename);
+      static void run (string_view contents, inode_state& state);
+};
+
+#endif
+
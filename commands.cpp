@@ -1,36 +1,114 @@
 // $Id: commands.cpp,v 1.17 2018-01-25 14:02:55-08 - - $
 
 #include "commands.h"
+#include "dcache.h"
 #include "debug.h"
+#include "find.h"
+#include "glob.h"
+#include "slab.h"
+#include "words.h"
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 
-command_hash cmd_hash{
-        {"cat",    fn_cat},
-        {"cd",     fn_cd},
-        {"echo",   fn_echo},
-        {"exit",   fn_exit},
-        {"ls",     fn_ls},
-        {"lsr",    fn_lsr},
-        {"make",   fn_make},
-        {"mkdir",  fn_mkdir},
-        {"prompt", fn_prompt},
-        {"pwd",    fn_pwd},
-        {"rm",     fn_rm},
-        {"rmr",     fn_rmr},
-};
-
-command_fn find_command_fn(const string &cmd) {
-    // Note: value_type is pair<const key_type, mapped_type>
-    // So: iterator->first is key_type (string)
-    // So: iterator->second is mapped_type (command_fn)
+// command_table -
+//    The commands, looked up through a perfect hash that is found at
+//    compile time.  Hash seeds are tried in turn until one sends every
+//    name to a different slot, so a lookup hashes the name once and
+//    compares it with at most one entry.
+
+namespace command_table {
+    struct entry {
+        string_view name;
+        command_fn fn;
+    };
+
+    constexpr entry commands[]{
+            {"cat",    fn_cat},
+            {"cd",     fn_cd},
+            {"du",     fn_du},
+            {"echo",   fn_echo},
+            {"exit",   fn_exit},
+            {"find",   fn_find},
+            {"locate", fn_locate},
+            {"ls",     fn_ls},
+            {"lsr",    fn_lsr},
+            {"make",   fn_make},
+            {"mkdir",  fn_mkdir},
+            {"prompt", fn_prompt},
+            {"pwd",    fn_pwd},
+            {"restore", fn_restore},
+            {"rm",     fn_rm},
+            {"rmr",     fn_rmr},
+            {"search", fn_search},
+            {"snapshot", fn_snapshot},
+            {"stats",  fn_stats},
+    };
+    constexpr size_t count = sizeof commands / sizeof commands[0];
+    constexpr size_t slots = 64;
+    static_assert(count < slots and (slots & (slots - 1)) == 0);
+
+    constexpr uint32_t name_hash(string_view name, uint32_t seed) {
+        uint32_t result = seed;
+        for (char letter: name) {
+            result = (result ^ static_cast<uint8_t>(letter)) * 16777619u;
+        }
+        return result ^ (result >> 15);
+    }
+
+    constexpr bool is_perfect(uint32_t seed) {
+        bool used[slots]{};
+        for (const auto &item: commands) {
+            size_t slot = name_hash(item.name, seed) & (slots - 1);
+            if (used[slot]) {
+                return false;
+            }
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    constexpr uint32_t find_seed() {
+        uint32_t seed = 2166136261u;
+        while (not is_perfect(seed)) {
+            ++seed;
+        }
+        return seed;
+    }
+
+    constexpr uint32_t seed = find_seed();
+
+    struct table {
+        int8_t index[slots];
+    };
+
+    constexpr table make_table() {
+        table result{};
+        for (auto &slot: result.index) {
+            slot = -1;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            result.index[name_hash(commands[i].name, seed) & (slots - 1)] =
+                    static_cast<int8_t>(i);
+        }
+        return result;
+    }
+
+    constexpr table lookup = make_table();
+}
 
+command_fn find_command_fn(string_view cmd) {
     DEBUGF ('c', "[" << cmd << "]");
-    const auto result = cmd_hash.find(cmd);
-    if (result == cmd_hash.end()) {
-        throw command_error(cmd + ": no such function\n");
+    using namespace command_table;
+    int index = lookup.index[name_hash(cmd, seed) & (slots - 1)];
+    if (index < 0 or commands[index].name != cmd) {
+        return nullptr;
     }
-    return result->second;
+    return commands[index].fn;
+}
+
+void no_such_command(string_view cmd) {
+    complain() << cmd << ": no such function" << endl << endl;
 }
 
 command_error::command_error(const string &what) :
@@ -43,40 +121,69 @@ int exit_status_message() {
     return exit_status;
 }
 
+// split_leaf -
+//    Splits a pathname into the part leading to the directory and the
+//    last name in it, as splitting on "/" and taking the last word off
+//    would.  The name is empty if the pathname has no words at all.
+//    Both are views into the pathname.
+
+static pair<string_view, string_view> split_leaf(string_view path) {
+    size_t end = path.find_last_not_of('/');
+    if (end == string_view::npos) {
+        return {"", ""};
+    }
+    size_t start = path.find_last_of('/', end);
+    start = start == string_view::npos ? 0 : start + 1;
+    return {path.substr(0, start), path.substr(start, end + 1 - start)};
+}
+
+// expand_operands -
+//    The operands of a command, with each pattern among them replaced
+//    by the pathnames it matches.  Those come parents first, or, for
+//    commands that remove things, deepest first.  A pattern that
+//    matches nothing is an error, as a missing pathname would be.
+
+static wordvec expand_operands(inode_state &state, const wordvec &words,
+                               bool deepest_first = false) {
+    wordvec operands;
+    for (size_t i = 1; i < words.size(); ++i) {
+        if (not glob::is_pattern(words[i])) {
+            operands.push_back(words[i]);
+            continue;
+        }
+        auto found = glob(words[i]).expand(state);
+        if (found.empty()) {
+            throw command_error(words.at(0) + " " + words[i] + ": path not found\n");
+        }
+        if (deepest_first) {
+            reverse(found.begin(), found.end());
+        }
+        for (auto &item: found) {
+            operands.push_back(move(item.path));
+        }
+    }
+    return operands;
+}
+
 void fn_cat(inode_state &state, const wordvec &words) {
     DEBUGF ('c', state);
     DEBUGF ('c', words);
-    auto cwinode = state.get_cwd();
-    auto content = cwinode.get()->get_contents();
-    auto dir = dynamic_cast<directory *>(content.get());
 
     if (words.size() == 1) {
         throw command_error(words[0] + ": file name not specified");
     }
 
-    for (uint j = 1; j < words.size(); j++) {
-        auto pathname = split(words.at(j), "/");
-        try {
-            auto dest = dir->search(pathname, state);
-            if (dest == nullptr) {
-                throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
-            }
-            auto file = dynamic_cast<plain_file *>(dest.get()->get_contents().get());
-            if (file == nullptr) {
-                cout << "not a file" << endl;
-                return;
-            }
-            auto data = file->get_data();
-            for (uint i = 0; i < data.size(); ++i) {
-                cout << data.at(i);
-                if (i < data.size() - 1) {
-                    cout << " ";
-                }
-            }
-            cout << endl;
-        } catch (out_of_range &e) {
-            cout << "file " << words.at(j) << " not found" << endl;
+    for (const auto &operand: expand_operands(state, words)) {
+        auto dest = dentry_cache::resolve(state, operand).node;
+        if (dest == nullptr) {
+            throw command_error(words.at(0) + " " + operand + ": path not found\n");
         }
+        auto file = dest->get_file();
+        if (file == nullptr) {
+            cout << "not a file" << endl;
+            return;
+        }
+        cout << file->readfile() << endl;
     }
 }
 
@@ -85,7 +192,7 @@ void fn_cd(inode_state &state, const wordvec &words) {
     DEBUGF ('c', words);
 
 
-    if ((words.size() == 1) or (((words.size()) == 2) and (words.at(1) == "/"))) {
+    if (words.size() == 1) {
         state.set_cwd(state.get_root());
         return;
     }
@@ -93,50 +200,120 @@ void fn_cd(inode_state &state, const wordvec &words) {
     if (words.size() > 2) {
         //error
     } else if (words.size() == 2) {
-        auto pathname = split(words.at(1), "/");
-        auto cwinode = state.get_cwd();
-        auto content = cwinode.get()->get_contents();
-        auto dir = dynamic_cast<directory *>(content.get());
-
         try {
-            auto ncwd = dir->search(pathname, state);
+            auto ncwd = dentry_cache::resolve(state, words.at(1)).node;
             if (ncwd == nullptr) {
                 throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
             }
 
-            if (dynamic_cast<directory *>(ncwd.get()->get_contents().get()) == nullptr) {
+            if (ncwd->get_directory() == nullptr) {
                 throw command_error(words.at(0) + " " + words.at(1) + ": is not a directory\n");
             }
-            state.set_cwd(ncwd);
+            state.set_cwd(ncwd->shared_from_this());
         } catch (exception &e) {
             cout << e.what();
         }
     }
 }
 
-void pwd_internal(inode_state &state, inode_ptr cwinode) {
-    auto content = cwinode.get()->get_contents();
-    auto currDir = dynamic_cast<directory *>(content.get());
+// pwd_internal -
+//    Prints the path of a directory in the live tree.  Each directory
+//    caches its own, so this does not walk up to the root.
 
-    auto dirents = currDir->get_dirents();
-    if (cwinode.get()->get_inode_nr() == 1) {
+void pwd_internal(const inode *cwinode) {
+    if (cwinode->get_inode_nr() == 1) {
         cout << "/" << endl;
     } else {
-        auto rootnode = state.get_root();
-        auto currnode = cwinode;
-        auto cnt = content;
-        wordvec v;
-        while (rootnode.get()->get_inode_nr() != currnode.get()->get_inode_nr()) {
-            cnt = currnode.get()->get_contents();
-            currDir = dynamic_cast<directory *>(cnt.get());
-            currnode = currDir->get_dirents().at("..");
-            v.push_back(currDir->get_name());
+        cout << cwinode->get_directory()->get_path();
+    }
+}
+
+// print_entry -
+//    Prints the inode number, the size and the name of one entry, as
+//    ls and lsr show it, without ending the line.
+
+static void print_entry(const string &name, const inode *node) {
+    cout << right << setw(6) << node->get_inode_nr() << "  " <<
+         setw(6) << node->size() << "  " <<
+         left << name;
+}
+
+// print_entries -
+//    Prints the entries of a directory, one print_entry to a line,
+//    with the given parent as dotdot.  Calls visit_subdir for each
+//    subdirectory other than dot and dotdot.
+
+template <typename visitor>
+static void print_entries(directory *dir, inode *parent,
+                          visitor visit_subdir) {
+    dir->for_each_entry(parent,
+            [&visit_subdir](const string &name, inode *node) {
+        print_entry(name, node);
+
+        if (node->get_type() == file_type::DIRECTORY_TYPE) {
+            if (name != ".." and name != ".") {
+                cout << "/";
+                visit_subdir(node);
+            }
         }
+        cout << endl;
+    });
+}
+
+// print_dirents -
+//    Prints the heading and the entries of a directory in the live
+//    tree.
 
-        for (int i = v.size() - 1; i >= 0; --i) {
-            cout << "/" << v.at(i);
+template <typename visitor>
+static void print_dirents(const inode *cwinode,
+                          visitor visit_subdir) {
+    if (cwinode->get_inode_nr() == 1) {
+        cout << "/:" << endl;
+    } else {
+        pwd_internal(cwinode);
+        cout << ":" << endl;
+    }
+    auto dir = cwinode->get_directory();
+    print_entries(dir, dir->get_parent(), visit_subdir);
+}
+
+// fn_du -
+//    Prints the bytes, plain files and directories below a path.
+//    The totals are kept up to date by every change to the tree, so
+//    this only costs the walk down the path, however big the subtree.
+
+void fn_du(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
+    if (words.size() > 2) {
+        throw command_error(words.at(0) + ": invalid number of parameters\n");
+    }
+    const inode *node = state.get_cwd().get();
+    if (words.size() == 2) {
+        node = dentry_cache::resolve(state, words.at(1)).node;
+        if (node == nullptr) {
+            throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
         }
     }
+
+    subtree_totals totals;
+    auto dir = node->get_directory();
+    if (dir != nullptr) {
+        totals = dir->get_totals();
+    } else {
+        totals.files = 1;
+        totals.bytes = node->size();
+    }
+    cout << right << setw(10) << totals.bytes << "  " <<
+         setw(6) << totals.files << "  " << setw(6) << totals.dirs << "  ";
+    if (dir == nullptr) {
+        cout << words.at(1);
+    } else if (node->get_inode_nr() == 1) {
+        cout << "/";
+    } else {
+        pwd_internal(node);
+    }
+    cout << endl;
 }
 
 void fn_echo(inode_state &state, const wordvec &words) {
@@ -166,165 +343,277 @@ void fn_exit(inode_state &state, const wordvec &words) {
     throw ysh_exit();
 }
 
-void fn_ls(inode_state &state, const wordvec &words) {
+// fn_find -
+//    find [path] [-name pattern] [-type f|d] [-size [+|-]n]
+//    Prints the pathname of every inode under the path, the path
+//    itself included, that passes all the tests, in pre-order: each
+//    directory comes just before everything below it, and the entries
+//    of a directory come in lexicographic order.  The path defaults
+//    to the cwd.
+
+void fn_find(inode_state &state, const wordvec &words) {
     DEBUGF ('c', state);
     DEBUGF ('c', words);
-    auto cwinode = state.get_cwd();
-    auto content = cwinode.get()->get_contents();
-    auto dir = dynamic_cast<directory *>(content.get());
-
-    if (words.size() > 1) {
-        wordvec pathname = split(words.at(1), "/");
-        auto ncwd = dir->search(pathname, state);
-        if (ncwd == nullptr) {
-            throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
+    find_query query;
+    string path = ".";
+    size_t i = 1;
+    if (i < words.size() and words.at(i).front() != '-') {
+        path = words.at(i++);
+    }
+    for (; i < words.size(); i += 2) {
+        const string &test = words.at(i);
+        if (i + 1 == words.size()) {
+            throw command_error(words.at(0) + " " + test + ": missing argument\n");
         }
-
-        if (dynamic_cast<directory *>(ncwd.get()->get_contents().get()) == nullptr) {
-            throw command_error(words.at(0) + " " + words.at(1) + ": is not a directory\n");
+        const string &value = words.at(i + 1);
+        if (test == "-name" and value.find('/') == string::npos) {
+            query.name(value);
+        } else if (test == "-type" and (value == "f" or value == "d")) {
+            query.type(value == "f" ? file_type::PLAIN_TYPE
+                                    : file_type::DIRECTORY_TYPE);
+        } else if (test == "-size") {
+            char relation = value.front() == '+' or value.front() == '-'
+                            ? value.front() : '=';
+            string digits = value.substr(relation == '=' ? 0 : 1);
+            if (digits.empty() or digits.size() > 18
+                or digits.find_first_not_of("0123456789") != string::npos) {
+                throw command_error(words.at(0) + " " + test + " " + value + ": invalid size\n");
+            }
+            query.size(relation, stoull(digits));
+        } else {
+            throw command_error(words.at(0) + " " + test + " " + value + ": invalid test\n");
         }
+    }
 
-        cwinode = ncwd;
+    auto start = dentry_cache::resolve(state, path).node;
+    if (start == nullptr) {
+        throw command_error(words.at(0) + " " + path + ": path not found\n");
+    }
+    for (const auto &found: query.search(start, path)) {
+        cout << found << endl;
     }
+}
 
-    content = cwinode.get()->get_contents();
-    dir = dynamic_cast<directory *>(content.get());
-    auto dirents = dir->get_dirents();
+// fn_locate -
+//    Prints the pathname of every inode in the live tree with the
+//    given name, from the name index rather than by walking, so the
+//    time goes with the number found.  Directories cache their own
+//    paths, as for pwd, and a file's is its parent's path and name.
 
-    if (cwinode.get()->get_inode_nr() == 1) {
-        cout << "/:" << endl;
-    } else {
-        pwd_internal(state, cwinode);
-        cout << ":" << endl;
+void fn_locate(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
+
+    if (words.size() != 2) {
+        throw command_error(words.at(0) + ": invalid number of parameters\n");
+    }
+    vector<string> paths;
+    for (inode *node: name_index::find(words.at(1))) {
+        auto dir = node->get_directory();
+        if (dir != nullptr) {
+            paths.push_back(dir->get_path());
+        } else {
+            paths.push_back(node->get_file()->get_parent()->get_path()
+                            + "/" + words.at(1));
+        }
+    }
+    sort(paths.begin(), paths.end());
+    for (const auto &path: paths) {
+        cout << path << endl;
     }
+}
 
-    for (auto it = dirents.begin(); it != dirents.end(); ++it) {
-        auto item = *it;
-        cout << right << setw(6) << item.second.get()->get_inode_nr() << "  " <<
-             setw(6) << item.second.get()->get_contents().get()->size() << "  " <<
-             left << item.first;
+// fn_search -
+//    Prints the pathname of every file in the live tree that contains
+//    all of the words, from the word index.  The index is built the
+//    first time it is needed and kept up to date from then on.
 
-        auto dr = dynamic_cast<directory *>(item.second.get()->get_contents().get());
-        if (dr != 0) {
-            if (item.first != ".." and item.first != ".") {
-                cout << "/";
+void fn_search(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
+
+    if (words.size() < 2) {
+        throw command_error(words.at(0) + ": invalid number of parameters\n");
+    }
+    if (not word_index::enabled()) {
+        word_index::build(state.get_root().get());
+    }
+    vector<string_view> wanted(words.begin() + 1, words.end());
+    vector<string> paths;
+    for (const auto &found: word_index::search(wanted)) {
+        auto parent = found.file->get_file()->get_parent();
+        paths.push_back(parent->get_path() + "/" + found.name.str());
+    }
+    sort(paths.begin(), paths.end());
+    for (const auto &path: paths) {
+        cout << path << endl;
+    }
+}
+
+// ls_snapshot -
+//    Lists @NAME/path, a directory in a snapshot.  The path is taken
+//    from the root of the snapshot.  Parent links describe the live
+//    tree, so the way down is kept to find dotdot and the heading.
+
+static void ls_snapshot(inode_state &state, const string &word) {
+    auto slash = word.find('/');
+    string name = word.substr(1, slash == string::npos ? slash : slash - 1);
+    auto top = state.get_snapshot(name);
+    if (top == nullptr) {
+        throw command_error("ls " + word + ": no such snapshot\n");
+    }
+
+    vector<inode *> way{top.get()};
+    string_view path(word);
+    path.remove_prefix(slash == string::npos ? path.size() : slash);
+    for (string_view part: path_names(path)) {
+        if (part == "..") {
+            if (way.size() > 1) {
+                way.pop_back();
+            }
+        } else if (part != ".") {
+            auto next = way.back()->get_directory()->child(part);
+            if (next == nullptr) {
+                throw command_error("ls " + word + ": path not found\n");
             }
+            if (next->get_directory() == nullptr) {
+                throw command_error("ls " + word + ": is not a directory\n");
+            }
+            way.push_back(next);
         }
-        cout << endl;
     }
+
+    cout << "@" << name;
+    for (size_t i = 1; i < way.size(); ++i) {
+        cout << "/" << way[i]->get_directory()->get_name();
+    }
+    cout << (way.size() == 1 ? "/:" : ":") << endl;
+    auto parent = way.size() == 1 ? way.back() : way.end()[-2];
+    print_entries(way.back()->get_directory(), parent,
+                  [](const inode *) {});
 }
 
-void fn_lsr(inode_state &state, const wordvec &words) {
+void fn_ls(inode_state &state, const wordvec &words) {
     DEBUGF ('c', state);
     DEBUGF ('c', words);
-    auto cwinode = state.get_cwd();
-    auto content = cwinode.get()->get_contents();
-    auto dir = dynamic_cast<directory *>(content.get());
+    const inode *cwinode = state.get_cwd().get();
 
+    if (words.size() > 1 and words.at(1).front() == '@') {
+        ls_snapshot(state, words.at(1));
+        return;
+    }
+    // A pattern prints a line for each plain file it matches, as ls
+    // would for the file alone, all of them first, and then lists each
+    // directory it matches under its heading, so that no file line
+    // follows a listing as if it were one of its entries.
+    if (words.size() > 1 and glob::is_pattern(words.at(1))) {
+        vector<const inode *> dirs;
+        for (const auto &item: glob(words.at(1)).expand(state)) {
+            if (item.node->get_directory() != nullptr) {
+                dirs.push_back(item.node);
+            } else {
+                print_entry(item.path, item.node);
+                cout << endl;
+            }
+            cwinode = nullptr;
+        }
+        for (const inode *dir: dirs) {
+            print_dirents(dir, [](const inode *) {});
+        }
+        if (cwinode != nullptr) {
+            throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
+        }
+        return;
+    }
     if (words.size() > 1) {
-        wordvec pathname = split(words.at(1), "/");
-        auto ncwd = dir->search(pathname, state);
+        auto ncwd = dentry_cache::resolve(state, words.at(1)).node;
         if (ncwd == nullptr) {
             throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
         }
 
-        if (dynamic_cast<directory *>(ncwd.get()->get_contents().get()) == nullptr) {
+        if (ncwd->get_directory() == nullptr) {
             throw command_error(words.at(0) + " " + words.at(1) + ": is not a directory\n");
         }
 
         cwinode = ncwd;
-        if (words.at(1) == "/") {
-            cwinode = state.get_root();
-
-        }
     }
 
-    content = cwinode.get()->get_contents();
-    dir = dynamic_cast<directory *>(content.get());
-    auto dirents = dir->get_dirents();
+    print_dirents(cwinode, [](const inode *) {});
+}
 
-    if (cwinode.get()->get_inode_nr() == 1) {
-        cout << "/:" << endl;
-    } else {
-        pwd_internal(state, cwinode);
-        cout << ":" << endl;
+// lsr_internal -
+//    Lists a directory, then each of its subdirectories in order.
+//    Nothing is copied on the way down; the tree cannot change while
+//    it is being listed.
+
+static void lsr_internal(const inode *cwinode) {
+    vector<const inode *> dirstack;
+    print_dirents(cwinode, [&dirstack](const inode *subdir) {
+        dirstack.push_back(subdir);
+    });
+    for (auto subdir: dirstack) {
+        lsr_internal(subdir);
     }
+}
+
+void fn_lsr(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
+    const inode *cwinode = state.get_cwd().get();
 
-    wordvec dirstack;
-    for (auto it = dirents.begin(); it != dirents.end(); ++it) {
-        auto item = *it;
-        cout << right << setw(6) << item.second.get()->get_inode_nr() << "  " <<
-             setw(6) << item.second.get()->get_contents().get()->size() << "  " <<
-             left << item.first;
+    if (words.size() > 1) {
+        auto ncwd = dentry_cache::resolve(state, words.at(1)).node;
+        if (ncwd == nullptr) {
+            throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
+        }
 
-        auto dr = dynamic_cast<directory *>(item.second.get()->get_contents().get());
-        if (dr != 0) {
-            if (item.first != ".." and item.first != ".") {
-                cout << "/";
-                dirstack.push_back(dr->get_name());
-            }
+        if (ncwd->get_directory() == nullptr) {
+            throw command_error(words.at(0) + " " + words.at(1) + ": is not a directory\n");
         }
-        cout << endl;
-    }
 
-    for (auto di:dirstack) {
-        wordvec newords;
-        inode_state nstate(state);
-        nstate.set_cwd(dir->get_dirents().at(di));
-        fn_lsr(nstate, newords);
+        cwinode = ncwd;
     }
+
+    lsr_internal(cwinode);
 }
 
 void fn_make(inode_state &state, const wordvec &words) {
     DEBUGF ('c', state);
     DEBUGF ('c', words);
-    auto cwinode = state.get_cwd();
-    auto content = cwinode.get()->get_contents();
 
     if (words.size() == 1) {
         throw command_error(words[0] + ": file name not specified");
     }
 
-    wordvec pathname = split(words.at(1), "/");
-    string target = pathname.back();
-    pathname.pop_back();
-    auto currdirr = dynamic_cast<directory *>(content.get());
-    try {
-        auto targetptr = currdirr->search(pathname, state);
-        if (targetptr == nullptr) {
-            throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
-        }
-        auto newfile = targetptr.get()->get_contents().get()->mkfile(target);
-        newfile.get()->get_contents().get()->writefile(words);
-
-
-    } catch (command_error& e) {
-        throw command_error(e.what());
+    auto found = dentry_cache::resolve(state, words.at(1));
+    if (found.node != nullptr) {
+        throw command_error(string(split_leaf(words.at(1)).second) + ": file or dir already exists");
     }
-    catch (exception &e) {
+    if (found.parent != nullptr and found.parent->get_directory() == nullptr) {
         throw command_error(words.at(0) + " " + words.at(1) + " :path does not exist\n");
     }
+    if (found.parent == nullptr or not found.leaf) {
+        throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
+    }
+    auto parent = state.writable(found.parent->shared_from_this());
+    parent->mkfile(found.missing)->writefile(words);
 }
 
 void fn_mkdir(inode_state &state, const wordvec &words) {
     DEBUGF ('c', state);
     DEBUGF ('c', words);
-    auto cwinode = state.get_cwd();
-    auto content = cwinode.get()->get_contents();
-    auto dir = dynamic_cast<directory *>(content.get());
-    wordvec pathname = split(words.at(1), "/");
-    string target = pathname.back();
-    pathname.pop_back();
-
-    auto tar = dir->search(pathname, state);
+    auto found = dentry_cache::resolve(state, words.at(1));
 
-    if (tar == nullptr) {
-        throw command_error(words.at(1) + " : path not found");
+    if (found.node != nullptr) {
+        throw command_error(string(split_leaf(words.at(1)).second) + ": file or dir already exists");
     }
-    if (dynamic_cast<directory *>(tar.get()->get_contents().get()) == 0) {
+    if (found.parent != nullptr and found.parent->get_directory() == nullptr) {
         throw command_error(words.at(1) + " : is not a directory");
     }
-    tar.get()->get_contents().get()->mkdir(tar, target);
+    if (found.parent == nullptr or not found.leaf) {
+        throw command_error(words.at(1) + " : path not found");
+    }
+    state.writable(found.parent->shared_from_this())->mkdir(found.missing);
 }
 
 void fn_prompt(inode_state &state, const wordvec &words) {
@@ -345,99 +634,155 @@ void fn_pwd(inode_state &state, const wordvec &words) {
     if (words.size() > 1) {
         throw command_error(words.at(0) + ": invalid number of parameters\n");
     }
-    pwd_internal(state, state.get_cwd());
+    pwd_internal(state.get_cwd().get());
     cout << endl;
 }
 
-void fn_rm(inode_state &state, const wordvec &words) {
-    DEBUGF ('c', state);
-    DEBUGF ('c', words);
-    auto cwinode = state.get_cwd();
-    auto content = cwinode.get()->get_contents();
-    auto dir = dynamic_cast<directory *>(content.get());
-    auto dirmap = dir->get_dirents();
-    wordvec pathname = split(words.at(1), "/");
-    string target = pathname.back();
-    pathname.pop_back();
+static void rm_path(inode_state &state, const string &command,
+                    const string &pathname) {
+    auto path = split_leaf(pathname);
+    string_view target = path.second;
 
     try {
-        auto searchdir = dir->search(pathname, state);
-        if (searchdir == nullptr) {
-            throw command_error(words.at(0) + " " + words.at(1) + ": path not found");
+        auto searchdir = dentry_cache::resolve(state, path.first).node;
+        if (searchdir == nullptr or target.empty()) {
+            throw command_error(command + " " + pathname + ": path not found");
         }
 
-        auto dr = dynamic_cast<directory* >(searchdir.get()->get_contents().get());
-        auto cnt = dr->get_dirents().at(target);
-        if (dynamic_cast<directory *>(cnt.get()->get_contents().get()) != 0) {
-            auto del = dynamic_cast<directory *>(cnt.get()->get_contents().get());
+        auto dr = searchdir->get_directory();
+        if (dr == nullptr) {
+            throw command_error(command + " " + pathname + ": path not found");
+        }
+        auto cnt = dr->child(target);
+        if (cnt == nullptr) {
+            throw command_error(command + ": not found");
+        }
+        if (cnt->get_directory() != nullptr) {
+            auto del = cnt->get_directory();
             if (del->size() > 2) {
-                throw command_error(words.at(0) + ": dir not empty");
+                throw command_error(command + ": dir not empty");
             }
 
 
         }
-            dr->remove(target);
+        state.writable(searchdir->shared_from_this())->remove(target);
 
 
     }
     catch (exception &e) {
-        throw command_error(words.at(0) + ": not found");
+        throw command_error(command + ": not found");
     }
 }
 
-void fn_rmr(inode_state &state, const wordvec &words) {
+void fn_rm(inode_state &state, const wordvec &words) {
     DEBUGF ('c', state);
     DEBUGF ('c', words);
-    auto cwinode = state.get_cwd();
-    auto content = cwinode.get()->get_contents();
-    auto dir = dynamic_cast<directory *>(content.get());
-
-    if (words.size() > 1) {
-        wordvec pathname = split(words.at(1), "/");
-        pathname.pop_back();
-        auto ncwd = dir->search(pathname, state);
-        if (ncwd == nullptr) {
-            throw command_error(words.at(0) + " " + words.at(1) + ": path not found\n");
-        }
+    if (words.size() == 1) {
+        throw command_error(words[0] + ": file name not specified");
+    }
+    for (const auto &operand: expand_operands(state, words, true)) {
+        rm_path(state, words.at(0), operand);
+    }
+}
 
-        if (dynamic_cast<directory *>(ncwd.get()->get_contents().get()) == nullptr) {
-            throw command_error(words.at(0) + " " + words.at(1) + ": is not a directory\n");
+// rmr_internal -
+//    Empties a directory, depth first.  Entries are removed from the
+//    back, which is the cheap end of a dirent_list.  A frozen
+//    subdirectory is shared with a snapshot, so it is only unlinked,
+//    not emptied.
+
+static void rmr_internal(directory *dir) {
+    auto &dirents = dir->get_dirents();
+    while (not dirents.empty()) {
+        auto &item = dirents.end()[-1];
+        auto dr = item.node->get_directory();
+        if (dr != nullptr and not item.node->frozen()) {
+            rmr_internal(dr);
         }
-
-        cwinode = ncwd;
-
+        dir->remove(item.name.str());
     }
+}
 
-    content = cwinode.get()->get_contents();
-    dir = dynamic_cast<directory *>(content.get());
-    auto dirents = dir->get_dirents();
-
-
-    wordvec dirstack;
-    for (auto it = dirents.begin(); it != dirents.end(); ++it) {
-        auto item = *it;
-
+// rmr_path -
+//    Removes the directory a pathname names, with everything in it.
+//    A pathname that ends in dot or dotdot, or that has no names at
+//    all, names a directory that cannot be unlinked from its parent,
+//    so that directory is only emptied.
+
+static void rmr_path(inode_state &state, const string &command,
+                     string_view pathname) {
+    auto path = split_leaf(pathname);
+    string_view target = path.second;
+
+    bool unlink = not target.empty() and target != "." and target != "..";
+    auto found = dentry_cache::resolve(state, unlink ? path.first : pathname).node;
+    if (found == nullptr) {
+        throw command_error(command + " " + string(pathname) + ": path not found\n");
+    }
+    if (found->get_directory() == nullptr) {
+        throw command_error(command + " " + string(pathname) + ": is not a directory\n");
+    }
+    auto dir = state.writable(found->shared_from_this())->get_directory();
+    if (not unlink) {
+        rmr_internal(dir);
+        return;
+    }
+    auto victim = dir->child(target);
+    if (victim == nullptr) {
+        throw command_error(command + " " + string(pathname) + ": path not found\n");
+    }
+    if (victim->get_directory() != nullptr and not victim->frozen()) {
+        rmr_internal(victim->get_directory());
+    }
+    dir->remove(target);
+}
 
-        auto dr = dynamic_cast<directory *>(item.second.get()->get_contents().get());
-        if (dr != 0) {
-            if (item.first != ".." and item.first != ".") {
+void fn_rmr(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
+    if (words.size() == 1) {
+        rmr_path(state, words.at(0), "");
+    }
+    for (const auto &operand: expand_operands(state, words, true)) {
+        rmr_path(state, words.at(0), operand);
+    }
+}
 
-                dirstack.push_back(dr->get_name());
-            }
-        } else {
-            dir->remove(item.first);
-        }
+void fn_snapshot(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
+    if (words.size() != 2) {
+        throw command_error(words.at(0) + ": invalid number of parameters\n");
     }
+    if (words.at(1).find('/') != string::npos) {
+        throw command_error(words.at(0) + " " + words.at(1) + ": invalid snapshot name\n");
+    }
+    state.snapshot(words.at(1));
+}
 
-    for (auto d : dirstack) {
-        wordvec newords;
-        inode_state nstate(state);
-        nstate.set_cwd(dir->get_dirents().at(d));
-        fn_rmr(nstate, newords);
-        dir->remove(d);
+void fn_restore(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
+    if (words.size() != 2) {
+        throw command_error(words.at(0) + ": invalid number of parameters\n");
+    }
+    if (not state.restore(words.at(1))) {
+        throw command_error(words.at(0) + " " + words.at(1) + ": no such snapshot\n");
     }
+}
 
 
+void fn_stats(inode_state &state, const wordvec &words) {
+    DEBUGF ('c', state);
+    DEBUGF ('c', words);
 
+    if (words.size() > 1) {
+        throw command_error(words.at(0) + ": invalid number of parameters\n");
+    }
+    cout << name_pool::stats() << endl;
+    cout << "inodes: " << inode_table::size() << " live, "
+         << slab_pool::get_backing() << " backed" << endl;
+    cout << inode_numbers::stats() << endl;
+    cout << dentry_cache::stats() << endl;
+    cout << slab_pool::stats() << endl;
 }
-
@@ -3,7 +3,7 @@
 #ifndef __COMMANDS_H__
 #define __COMMANDS_H__
 
-#include <unordered_map>
+#include <string_view>
 using namespace std;
 
 #include "file_sys.h"
@@ -12,7 +12,6 @@ using namespace std;
 // A couple of convenient usings to avoid verbosity.
 
 using command_fn = void (*)(inode_state& state, const wordvec& words);
-using command_hash = unordered_map<string,command_fn>;
 
 // command_error -
 //    Extend runtime_error for throwing exceptions related to this 
@@ -24,21 +23,38 @@ class command_error: public runtime_error {
 };
 
 // execution functions -
+//    Each writes its output to cout, over whatever sink it has been
+//    given: the shell's output, a pipeline, or a redirected file.
 
 void fn_cat    (inode_state& state, const wordvec& words);
 void fn_cd     (inode_state& state, const wordvec& words);
+void fn_du     (inode_state& state, const wordvec& words);
 void fn_echo   (inode_state& state, const wordvec& words);
 void fn_exit   (inode_state& state, const wordvec& words);
+void fn_find   (inode_state& state, const wordvec& words);
+void fn_locate (inode_state& state, const wordvec& words);
 void fn_ls     (inode_state& state, const wordvec& words);
 void fn_lsr    (inode_state& state, const wordvec& words);
 void fn_make   (inode_state& state, const wordvec& words);
 void fn_mkdir  (inode_state& state, const wordvec& words);
 void fn_prompt (inode_state& state, const wordvec& words);
 void fn_pwd    (inode_state& state, const wordvec& words);
+void fn_restore (inode_state& state, const wordvec& words);
 void fn_rm     (inode_state& state, const wordvec& words);
 void fn_rmr    (inode_state& state, const wordvec& words);
+void fn_search (inode_state& state, const wordvec& words);
+void fn_snapshot (inode_state& state, const wordvec& words);
+void fn_stats  (inode_state& state, const wordvec& words);
 
-command_fn find_command_fn (const string& command);
+// find_command_fn -
+//    The function for a command, or nullptr if there is no such
+//    command.  The table is a perfect hash built at compile time, so
+//    the name is hashed once and nothing is allocated or thrown.
+// no_such_command -
+//    Reports a command that find_command_fn did not know.
+
+command_fn find_command_fn (string_view command);
+void no_such_command (string_view command);
 
 // exit_status_message -
 //    Prints an exit message and returns the exit status, as recorded
@@ -0,0 +1,213 @@
+// $Id$
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "dcache.h"
+#include "debug.h"
+#include "locks.h"
+
+// key -
+//    Where a walk started and the path it followed.  The start cannot
+//    be freed and another inode put at its address while the entry is
+//    cached, since the first step of the trail holds a weak reference
+//    to it, which keeps its memory.
+// step -
+//    A directory passed through, with the generation it had at the
+//    time.  The weak reference says whether it is still alive before
+//    anything in it is read.
+// intact -
+//    Whether every directory on a trail is alive and has kept its
+//    generation.
+// entry -
+//    The directories passed through, and where the walk ended.  The
+//    missing name is kept as its place in the path, since the path it
+//    viewed is gone.  A walk that found its inode stays good while no
+//    directory on the trail loses an entry or changes its dotdot.  A
+//    walk that missed also depends on what the last directory holds,
+//    and goes stale when that one gains an entry.
+
+struct key {
+   const inode* start;
+   string path;
+   bool operator== (const key& that) const {
+      return start == that.start and path == that.path;
+   }
+};
+
+struct key_hash {
+   size_t operator() (const key& item) const {
+      return hash<string>() (item.path)
+           ^ hash<const inode*>() (item.start) * 31;
+   }
+};
+
+using step = dentry_cache::step;
+
+static bool intact (const vector<step>& trail) {
+   for (const auto& item: trail) {
+      if (item.owner.expired()) return false;
+      if (item.dir->get_generation() != item.generation) return false;
+   }
+   return true;
+}
+
+static void record (vector<step>& trail, const directory* dir) {
+   trail.push_back ({dir->get_inode()->weak_from_this(), dir,
+                     dir->get_generation()});
+}
+
+struct entry {
+   vector<step> trail;
+   inode* node {nullptr};
+   inode* parent {nullptr};
+   size_t missing_at {0};
+   size_t missing_size {0};
+   bool leaf {false};
+   bool missed {false};
+   uint64_t additions {0};
+   bool valid() const {
+      if (not intact (trail)) return false;
+      return not missed
+          or trail.back().dir->get_additions() == additions;
+   }
+};
+
+static unordered_map<key,entry,key_hash>& entries() {
+   static unordered_map<key,entry,key_hash> table;
+   return table;
+}
+
+static mutex& table_lock() {
+   static mutex lock;
+   return lock;
+}
+
+static size_t hits {0};
+static size_t misses {0};
+static dentry_cache::anchor* anchored {nullptr};
+
+bool dentry_cache::anchor::valid (const inode* from) const {
+   return from == start and not trail.empty() and intact (trail);
+}
+
+// find -
+//    The trail has every directory a name was looked up in, so the
+//    directory found goes stale when it is removed from its parent.
+//    A prefix that does not lead to a directory leaves dir nullptr.
+
+void dentry_cache::anchor::find (const inode_ptr& from) {
+   start = from.get();
+   trail.clear();
+   path_result found = from->get_directory()->resolve (prefix,
+                       [this] (const directory* on_way) {
+                          record (trail, on_way);
+                       });
+   dir = found.node;
+   if (dir != nullptr and dir->get_directory() == nullptr) dir = nullptr;
+}
+
+// through -
+//    Takes a path from the anchor, which must be a prefix of it.  If
+//    the prefix does not lead to a directory, the path is walked from
+//    the start, so that what is missing is reported as usual.
+
+static path_result through (dentry_cache::anchor& at,
+                            const inode_ptr& start, string_view path) {
+   if (at.valid (start.get())) {
+      ++hits;
+   }else {
+      ++misses;
+      at.find (start);
+   }
+   if (at.dir == nullptr) return start->get_directory()->resolve (path);
+   return at.dir->get_directory()->resolve (path.substr (at.prefix.size()));
+}
+
+void dentry_cache::use (anchor* where) {
+   anchored = where;
+}
+
+// make_room -
+//    Drops the stale entries, and everything only if that was not
+//    enough.
+
+static void make_room (unordered_map<key,entry,key_hash>& table) {
+   for (auto item = table.begin(); item != table.end();) {
+      if (item->second.valid()) ++item;
+                           else item = table.erase (item);
+   }
+   if (table.size() >= dentry_cache::CAPACITY) table.clear();
+}
+
+path_result dentry_cache::resolve (const inode_ptr& start,
+                                   string_view path) {
+   if (anchored != nullptr and path.size() > anchored->prefix.size()
+       and path.substr (0, anchored->prefix.size()) == anchored->prefix) {
+      return through (*anchored, start, path);
+   }
+   key probe {start.get(), string (path)};
+   auto& table = entries();
+   {
+      guard<mutex> held (table_lock());
+      auto found = table.find (probe);
+      if (found != table.end() and found->second.valid()) {
+         ++hits;
+         const entry& walk = found->second;
+         return {walk.node, walk.parent,
+                 path.substr (walk.missing_at, walk.missing_size),
+                 walk.leaf};
+      }
+      ++misses;
+   }
+
+   entry walk;
+   path_result result = start->get_directory()->resolve (path,
+                        [&walk] (const directory* dir) {
+                           record (walk.trail, dir);
+                        });
+   // An empty path leads to the start itself, which is not cached.
+   if (walk.trail.empty()) return result;
+   walk.node = result.node;
+   walk.parent = result.parent;
+   if (not result.missing.empty()) {
+      walk.missing_at = result.missing.data() - path.data();
+   }
+   walk.missing_size = result.missing.size();
+   walk.leaf = result.leaf;
+   walk.missed = result.node == nullptr;
+   walk.additions = walk.trail.back().dir->get_additions();
+   DEBUGF ('d', path << " -> " << result.node);
+   guard<mutex> held (table_lock());
+   if (table.size() >= CAPACITY and table.count (probe) == 0) {
+      make_room (table);
+   }
+   table[move (probe)] = move (walk);
+   return result;
+}
+
+path_result dentry_cache::resolve (const inode_state& state,
+                                   string_view path) {
+   bool absolute = not path.empty() and path.front() == '/';
+   return resolve (absolute ? state.get_root() : state.get_cwd(), path);
+}
+
+dentry_cache::statistics dentry_cache::stats() {
+   statistics result;
+   result.hits = hits;
+   result.misses = misses;
+   result.entries = entries().size();
+   return result;
+}
+
+ostream& operator<< (ostream& out, const dentry_cache::statistics& stats) {
+   return out << "dentries: " << stats.hits << " hits, "
+              << stats.misses << " misses, " << stats.entries
+              << " cached";
+}
+
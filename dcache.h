@@ -0,0 +1,96 @@
+// $Id$
+
+// dcache -
+//    A cache of path lookups, so that a script that names the same
+//    deep paths over and over does not walk them one name at a time
+//    each time.
+
+#ifndef __DCACHE_H__
+#define __DCACHE_H__
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+
+// class dentry_cache -
+//    Maps a starting directory and a path onto the inode the path
+//    leads to.  Each entry also records every directory the walk went
+//    through along with its generation, and a walk that found its
+//    inode is used only while none of those generations has changed:
+//    while no directory on the way has lost an entry or changed its
+//    dotdot.  Adding entries to them does not matter.  Paths that lead
+//    nowhere are cached too, so probing for a missing path costs no
+//    more than finding one, and those also depend on the additions to
+//    the directory where the name was missing.  Generations are never
+//    the same for two directories, and every directory on the trail
+//    is held by a weak reference, so an entry can neither be stale
+//    nor read a directory that is gone.
+// resolve -
+//    Follows a path from the start directory, as directory::resolve
+//    does, and returns where it leads, with missing a view into the
+//    path given.  Given the state instead, an absolute path starts at
+//    the root and any other at the cwd.  While the tree is threaded,
+//    the cache is used as ever, under a lock that is let go while a
+//    path is walked, so a batch counts the same hits and misses as
+//    running its commands in order would, give or take the order in
+//    which a full cache is emptied.
+// use -
+//    Makes resolve take every path that starts with the anchor's
+//    prefix from the anchor's directory, until it is called again,
+//    perhaps with nullptr.  Only the rest of the path is walked.
+// CAPACITY -
+//    The most entries kept.  When the cache is full, the stale
+//    entries are dropped, and everything only if none was stale.
+// stats -
+//    The hits, misses, and entries in the cache.
+
+class dentry_cache {
+   public:
+      struct step {
+         weak_ptr<inode> owner;
+         const directory* dir;
+         uint64_t generation;
+      };
+      struct anchor;
+      struct statistics {
+         size_t hits {0};
+         size_t misses {0};
+         size_t entries {0};
+      };
+      static constexpr size_t CAPACITY = 4096;
+      static path_result resolve (const inode_ptr& start,
+                                  string_view path);
+      static path_result resolve (const inode_state& state,
+                                  string_view path);
+      static void use (anchor* where);
+      static statistics stats();
+};
+
+// struct dentry_cache::anchor -
+//    A directory found once and kept for as long as it stays where it
+//    was, for whoever resolves many paths through it.  Prefix is the
+//    path to it, ending in a slash, from the start it was found from.
+//    Like a cache entry, it holds the trail of directories the walk
+//    went through, and it is good while none of them has lost an
+//    entry or changed its dotdot.  Entries added on the way, or in
+//    the directory itself, leave it good.  Taking a path from a good
+//    anchor counts as a hit, and finding it again as a miss.
+
+struct dentry_cache::anchor {
+   string_view prefix;
+   const inode* start {nullptr};
+   vector<step> trail;
+   inode* dir {nullptr};
+   bool valid (const inode* from) const;
+   void find (const inode_ptr& from);
+};
+
+ostream& operator<< (ostream&, const dentry_cache::statistics&);
+
+#endif
+
@@ -17,6 +17,8 @@ using namespace std;
 // getflag -
 //    Used by the DEBUGF macro to check to see if a flag has been set.
 //    Not to be called by user code.
+// any -
+//    Whether any flag is set at all.
 
 class debugflags {
    private:
@@ -25,6 +27,7 @@ class debugflags {
    public:
       static void setflags (const string& optflags);
       static bool getflag (char flag);
+      static bool any() { return flags.any(); }
       static void where (char flag, const char* file, int line,
                          const char* pretty_function);
 };
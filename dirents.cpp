@@ -0,0 +1,281 @@
+// $Id$
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#include "dirents.h"
+#include "file_sys.h"
+
+bool dirent_list::is_inline() const {
+   return data_ == reinterpret_cast<const dirent*> (inline_);
+}
+
+dirent_list::dirent* dirent_list::inline_data() {
+   return reinterpret_cast<dirent*> (inline_);
+}
+
+dirent_list::dirent_list(): data_ (inline_data()) {
+}
+
+dirent_list::dirent_list (const dirent_list& that): dirent_list() {
+   if (that.size_ > capacity_) {
+      data_ = static_cast<dirent*> (
+              ::operator new (that.size_ * sizeof (dirent)));
+      capacity_ = that.size_;
+   }
+   uninitialized_copy (that.begin(), that.end(), data_);
+   size_ = that.size_;
+   sorted_ = that.sorted_;
+   for (const auto& entry: *this) name_pool::acquire (entry.name);
+   if (that.hashed()) build_index();
+}
+
+dirent_list::dirent_list (dirent_list&& that) noexcept: dirent_list() {
+   swap (that);
+}
+
+dirent_list& dirent_list::operator= (dirent_list that) {
+   swap (that);
+   return *this;
+}
+
+dirent_list::~dirent_list() {
+   clear();
+   if (not is_inline()) ::operator delete (data_);
+}
+
+// swap -
+//    Heap buffers are exchanged by pointer.  Inline buffers must have
+//    their elements moved, since they live inside the object.
+
+void dirent_list::swap (dirent_list& that) noexcept {
+   std::swap (slots_, that.slots_);
+   std::swap (nslots_, that.nslots_);
+   std::swap (sorted_, that.sorted_);
+   if (not is_inline() and not that.is_inline()) {
+      std::swap (data_, that.data_);
+      std::swap (size_, that.size_);
+      std::swap (capacity_, that.capacity_);
+      return;
+   }
+   dirent_list& small = is_inline() ? *this : that;
+   dirent_list& other = is_inline() ? that : *this;
+   dirent saved[INLINE_CAPACITY];
+   uint32_t saved_size = small.size_;
+   move (small.begin(), small.end(), saved);
+   destroy (small.begin(), small.end());
+   if (other.is_inline()) {
+      uninitialized_move (other.begin(), other.end(), small.data_);
+      small.size_ = other.size_;
+      destroy (other.begin(), other.end());
+   }else {
+      small.data_ = other.data_;
+      small.size_ = other.size_;
+      small.capacity_ = other.capacity_;
+      other.data_ = other.inline_data();
+      other.capacity_ = INLINE_CAPACITY;
+   }
+   uninitialized_move (saved, saved + saved_size, other.data_);
+   other.size_ = saved_size;
+}
+
+void dirent_list::grow() {
+   uint32_t new_capacity = capacity_ * 2;
+   dirent* new_data = static_cast<dirent*> (
+                      ::operator new (new_capacity * sizeof (dirent)));
+   uninitialized_move (begin(), end(), new_data);
+   destroy (begin(), end());
+   if (not is_inline()) ::operator delete (data_);
+   data_ = new_data;
+   capacity_ = new_capacity;
+}
+
+// home -
+//    Where a name's probe sequence starts.  Handles are handed out in
+//    sequence, so they are scattered by Fibonacci hashing first.
+// slot_of -
+//    The slot holding the name, or the empty one where it would go.
+
+size_t dirent_list::home (fname name) const {
+   uint64_t scattered = name.id() * UINT64_C (0x9E3779B97F4A7C15);
+   return (scattered >> 32) & (nslots_ - 1);
+}
+
+size_t dirent_list::slot_of (fname name) const {
+   size_t mask = nslots_ - 1;
+   for (size_t slot = home (name);; slot = (slot + 1) & mask) {
+      uint32_t index = slots_[slot];
+      if (index == 0 or data_[index - 1].name == name) return slot;
+   }
+}
+
+void dirent_list::build_index() {
+   uint32_t count = 2 * HASH_MIN;
+   while (count < 2 * size_) count *= 2;
+   slots_.reset (new uint32_t[count]());
+   nslots_ = count;
+   for (uint32_t index = 0; index < size_; ++index) {
+      slots_[slot_of (data_[index].name)] = index + 1;
+   }
+}
+
+// unindex -
+//    Empties a slot.  With linear probing the entries after it in the
+//    same run are shifted back into the hole if it lies between their
+//    home and where they are now, so no tombstones are needed.
+
+void dirent_list::unindex (size_t slot) {
+   size_t mask = nslots_ - 1;
+   size_t hole = slot;
+   for (size_t next = (hole + 1) & mask; slots_[next] != 0;
+        next = (next + 1) & mask) {
+      size_t want = home (data_[slots_[next] - 1].name);
+      if (((next - want) & mask) >= ((next - hole) & mask)) {
+         slots_[hole] = slots_[next];
+         hole = next;
+      }
+   }
+   slots_[hole] = 0;
+}
+
+// sort -
+//    The names are fetched from the pool once, sorted as views along
+//    with where each entry is, and the entries are then moved into a
+//    new buffer in that order.
+
+void dirent_list::sort() {
+   if (sorted_) return;
+   vector<pair<string_view,uint32_t>> order;
+   order.reserve (size_);
+   for (uint32_t index = 0; index < size_; ++index) {
+      order.emplace_back (data_[index].name.str(), index);
+   }
+   std::sort (order.begin(), order.end());
+   vector<dirent> in_order;
+   in_order.reserve (size_);
+   for (const auto& position: order) {
+      in_order.push_back (std::move (data_[position.second]));
+   }
+   std::move (in_order.begin(), in_order.end(), data_);
+   sorted_ = true;
+   if (hashed()) build_index();
+}
+
+dirent_list::const_iterator dirent_list::seek (string_view text)
+const {
+   return std::lower_bound (begin(), end(), text,
+          [] (const dirent& entry, string_view key) {
+             return string_view (entry.name.str()) < key;
+          });
+}
+
+dirent_list::iterator dirent_list::find (fname name) {
+   if (not name.valid()) return end();
+   if (hashed()) {
+      uint32_t index = slots_[slot_of (name)];
+      return index == 0 ? end() : begin() + index - 1;
+   }
+   for (auto pos = begin(); pos != end(); ++pos) {
+      if (pos->name == name) return pos;
+   }
+   return end();
+}
+
+dirent_list::const_iterator dirent_list::find (fname name) const {
+   return const_cast<dirent_list*> (this)->find (name);
+}
+
+dirent_list::const_iterator dirent_list::find (string_view name)
+const {
+   return find (fname::lookup (name));
+}
+
+bool dirent_list::insert (string_view name, const inode_ptr& node) {
+   return insert (fname (name), node);
+}
+
+bool dirent_list::insert (fname name, const inode_ptr& node) {
+   size_t slot = 0;
+   if (hashed()) {
+      slot = slot_of (name);
+      if (slots_[slot] != 0) return false;
+   }else if (find (name) != end()) {
+      return false;
+   }
+   if (size_ == capacity_) grow();
+   if (sorted_ and size_ > 0 and not (end()[-1].name < name)) {
+      sorted_ = false;
+   }
+   new (end()) dirent {name, node};
+   ++size_;
+   if (hashed() and 2 * size_ <= nslots_) {
+      slots_[slot] = size_;
+   }else if (size_ > HASH_MIN) {
+      build_index();
+   }
+   name_pool::acquire (name);
+   return true;
+}
+
+// erase -
+//    The name is released last, since the index is probed by it and
+//    releasing it may free it.
+
+void dirent_list::erase (iterator pos) {
+   fname name = pos->name;
+   if (not hashed()) {
+      move (pos + 1, end(), pos);
+      --size_;
+      end()->~dirent();
+      name_pool::release (name);
+      return;
+   }
+   unindex (slot_of (name));
+   iterator last = end() - 1;
+   if (pos != last) {
+      slots_[slot_of (last->name)] = pos - begin() + 1;
+      *pos = std::move (*last);
+      sorted_ = false;
+   }
+   --size_;
+   end()->~dirent();
+   if (size_ < HASH_MIN / 2) {
+      slots_.reset();
+      nslots_ = 0;
+   }
+   name_pool::release (name);
+}
+
+bool dirent_list::erase (fname name) {
+   auto pos = find (name);
+   if (pos == end()) return false;
+   erase (pos);
+   return true;
+}
+
+bool dirent_list::erase (string_view name) {
+   return erase (fname::lookup (name));
+}
+
+const inode_ptr& dirent_list::at (string_view name) const {
+   auto pos = find (name);
+   if (pos == end()) {
+      throw out_of_range ("dirent_list::at: " + string (name));
+   }
+   return pos->node;
+}
+
+void dirent_list::clear() {
+   for (const auto& entry: *this) name_pool::release (entry.name);
+   destroy (begin(), end());
+   size_ = 0;
+   slots_.reset();
+   nslots_ = 0;
+   sorted_ = true;
+}
+
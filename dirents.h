@@ -0,0 +1,116 @@
+// $Id$
+
+// dirents -
+//    Storage for the entries of a directory.
+
+#ifndef __DIRENTS_H__
+#define __DIRENTS_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+using namespace std;
+
+#include "names.h"
+
+class inode;
+using inode_ptr = shared_ptr<inode>;
+
+// class dirent_list -
+//    A contiguous array of (name, inode) pairs.  Entries are appended
+//    in whatever order they come, so an insert never moves the ones
+//    already there, and the array is sorted only when someone asks
+//    for it in order.  Up to HASH_MIN entries, lookup is a scan of
+//    the name handles in adjacent memory, with no string compared.
+//    Beyond that, entries are found through an open addressing hash
+//    index on the handles, which is dropped again when the list
+//    shrinks below HASH_MIN / 2.  The first few entries live in an
+//    inline buffer inside the object, so a small directory needs no
+//    separate allocation for its entries at all.  Names are interned
+//    handles, held on behalf of the name_pool.
+// begin, end -
+//    Iterate in no particular order, which is all that copying or
+//    tearing down a directory needs.
+// sort, is_sorted -
+//    Puts the entries in lexicographic order, which is what ls and
+//    lsr print, if they are not already.  Sorting moves the entries,
+//    so, like an insert, it must not run alongside anything reading
+//    the list.
+// seek -
+//    The first entry whose name is not less than the given text, in
+//    a list that is_sorted(), found by binary search.
+// find -
+//    Returns a pointer to the entry, or end() if it does not exist.
+//    Looking up by string_view never interns the name, so a name no
+//    file has ever had is rejected at once.
+// insert -
+//    Adds an entry.  Returns false, and changes nothing, if the name
+//    is already present.
+// erase -
+//    Removes the named entry.  Returns false if it was not present.
+//    Erasing by position may move the last entry into its place.
+// at -
+//    Returns the inode of the named entry, or throws out_of_range.
+
+class dirent_list {
+   public:
+      struct dirent {
+         fname name;
+         inode_ptr node;
+      };
+      using iterator = dirent*;
+      using const_iterator = const dirent*;
+      static constexpr size_t INLINE_CAPACITY = 4;
+      static constexpr size_t HASH_MIN = 32;
+   private:
+      dirent* data_;
+      uint32_t size_ {0};
+      uint32_t capacity_ {INLINE_CAPACITY};
+      // Slots hold an index into the array plus one, or zero if empty.
+      // The table is a power of two in size and at most half full.
+      unique_ptr<uint32_t[]> slots_;
+      uint32_t nslots_ {0};
+      bool sorted_ {true};
+      alignas(dirent) unsigned char inline_[INLINE_CAPACITY
+                                            * sizeof (dirent)];
+      bool is_inline() const;
+      dirent* inline_data();
+      void grow();
+      bool hashed() const { return nslots_ != 0; }
+      size_t home (fname name) const;
+      size_t slot_of (fname name) const;
+      void build_index();
+      void unindex (size_t slot);
+   public:
+      dirent_list();
+      dirent_list (const dirent_list&);
+      dirent_list (dirent_list&&) noexcept;
+      dirent_list& operator= (dirent_list);
+      ~dirent_list();
+      void swap (dirent_list&) noexcept;
+
+      size_t size() const { return size_; }
+      bool empty() const { return size_ == 0; }
+      iterator begin() { return data_; }
+      iterator end() { return data_ + size_; }
+      const_iterator begin() const { return data_; }
+      const_iterator end() const { return data_ + size_; }
+      void sort();
+      bool is_sorted() const { return sorted_; }
+      const_iterator seek (string_view text) const;
+
+      iterator find (fname name);
+      const_iterator find (fname name) const;
+      const_iterator find (string_view name) const;
+      bool insert (fname name, const inode_ptr& node);
+      bool insert (string_view name, const inode_ptr& node);
+      bool erase (fname name);
+      bool erase (string_view name);
+      void erase (iterator pos);
+      const inode_ptr& at (string_view name) const;
+      void clear();
+};
+
+#endif
+
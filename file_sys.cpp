@@ -1,5 +1,6 @@
 // $Id: file_sys.cpp,v 1.6 2018-06-27 14:44:57-07 - - $
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <unordered_map>
@@ -12,8 +13,15 @@ using namespace std;
 
 #include "debug.h"
 #include "file_sys.h"
+#include "locks.h"
+#include "slab.h"
+#include "words.h"
 
-int inode::next_inode_nr{1};
+uint32_t inode::epoch_now{0};
+atomic<uint64_t> directory::generations{0};
+atomic<uint64_t> directory::relinks{1};
+size_t inode_table::live{0};
+size_t name_index::count{0};
 
 struct file_type_hash {
     size_t operator()(file_type type) const {
@@ -30,12 +38,13 @@ ostream &operator<<(ostream &out, file_type type) {
 }
 
 inode_ptr directory::mk_root_dir() {
-    inode_ptr dir(new inode(file_type::DIRECTORY_TYPE));
+    inode_ptr dir = inode::make(file_type::DIRECTORY_TYPE,
+                                inode_numbers::ROOT);
 
-    auto nd = dynamic_cast<directory *>(dir.get()->get_contents().get());
-    nd->dirents["."] = dir;
-    nd->dirents[".."] = dir;
-    nd->name = "root";
+    auto nd = dir->get_directory();
+    nd->dotdot = dir.get();
+    nd->set_name(fname("root"));
+    nd->located = true;
 
     return dir;
 }
@@ -57,6 +66,7 @@ inode_state::inode_state(const inode_state &state) {
     this->root = state.root;
     this->cwd = state.cwd;
     this->prompt_ = state.prompt_;
+    this->snapshots = state.snapshots;
 }
 
 const inode_ptr &inode_state::get_cwd() const {
@@ -79,170 +89,754 @@ void inode_state::set_prompt(const string &newPrompt) {
     this->prompt_ = newPrompt;
 }
 
-inode::inode(file_type type) : inode_nr(next_inode_nr++) {
+void inode_state::snapshot(const string &name) {
+    DEBUGF ('i', name << " = " << root);
+    this->snapshots[name] = this->root;
+    ++inode::epoch_now;
+}
+
+bool inode_state::restore(const string &name) {
+    auto found = this->snapshots.find(name);
+    if (found == this->snapshots.end()) {
+        return false;
+    }
+    // The name index is built again from scratch, and must forget the
+    // old tree while it is still there.  The word index is turned off
+    // until the next search builds it again.
+    name_index::clear();
+    word_index::clear();
+    this->root->get_directory()->located = false;
+    this->cwd = found->second;
+    this->root = found->second;
+    this->detached = nullptr;
+    ++inode::epoch_now;
+
+    // The parent links and table entries of the restored inodes may
+    // point at later versions, or at nothing, so set them all again.
+    inode_table::clear();
+    this->root->get_directory()->located = true;
+    vector<inode *> pending{this->root.get()};
+    while (not pending.empty()) {
+        inode *node = pending.back();
+        pending.pop_back();
+        inode_table::revive(node);
+        auto dir = node->get_directory();
+        if (dir != nullptr) {
+            dir->adopt_entries();
+            for (auto &entry: dir->dirents) {
+                name_index::add(entry.name, entry.node.get());
+                pending.push_back(entry.node.get());
+            }
+            dir->located = true;
+        }
+    }
+    return true;
+}
+
+inode_ptr inode_state::get_snapshot(const string &name) const {
+    auto found = this->snapshots.find(name);
+    return found == this->snapshots.end() ? nullptr : found->second;
+}
+
+// parent_of -
+//    The parent of an inode in the live tree, or nullptr for the
+//    root and for the top of an orphaned subtree.
+
+static inode *parent_of(const inode *node) {
+    auto dir = node->get_directory();
+    if (dir == nullptr) {
+        auto parent = node->get_file()->get_parent();
+        return parent == nullptr ? nullptr : parent->get_inode();
+    }
+    auto parent = dir->get_parent();
+    return parent == node ? nullptr : parent;
+}
+
+inode_ptr inode_state::writable(const inode_ptr &node) {
+    if (not node->frozen()) {
+        return node;
+    }
+    vector<inode *> path;
+    inode *above = node.get();
+    while (above != nullptr and above->frozen()) {
+        path.push_back(above);
+        above = parent_of(above);
+    }
+
+    // Copy from the top down, so each copy goes into a parent that
+    // has already been copied.
+    inode_ptr copy;
+    for (size_t i = path.size(); i-- > 0;) {
+        inode_ptr original = path[i]->shared_from_this();
+        copy = allocate_shared<inode>(slab_allocator<inode>(),
+                                      original.get());
+        auto dir = copy->get_directory();
+        if (dir != nullptr) {
+            dir->adopt_entries();
+            dir->dotdot = above;
+        } else {
+            copy->get_file()->parent =
+                    above == nullptr ? nullptr : above->get_directory();
+        }
+        if (above != nullptr) {
+            above->get_directory()->replace(original.get(), copy);
+        } else if (original == this->root) {
+            dir->dotdot = copy.get();
+            dir->located = true;
+            original->get_directory()->located = false;
+            this->root = copy;
+        } else {
+            this->detached = copy;
+        }
+        if (original == this->cwd) {
+            this->cwd = copy;
+        }
+        above = copy.get();
+    }
+    DEBUGF ('i', node << " -> " << copy);
+    return copy;
+}
+
+inode::inode(file_type new_type, inode_nr_t nr) :
+        inode_nr(nr), epoch(epoch_now), type(new_type) {
     switch (type) {
         case file_type::PLAIN_TYPE:
-            contents = make_shared<plain_file>();
+            contents.file = new(slab_allocator<plain_file>().allocate(1))
+                    plain_file();
             break;
         case file_type::DIRECTORY_TYPE:
-            contents = make_shared<directory>();
+            contents.dir = new(slab_allocator<directory>().allocate(1))
+                    directory();
+            contents.dir->dot = this;
             break;
     }
+    inode_table::enter(this);
     DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
 }
 
-base_file_ptr inode::get_contents() const {
-    return contents;
+inode::inode(const inode *original) :
+        inode_nr(original->inode_nr), epoch(epoch_now),
+        type(original->type) {
+    switch (type) {
+        case file_type::PLAIN_TYPE:
+            contents.file = new(slab_allocator<plain_file>().allocate(1))
+                    plain_file(*original->contents.file);
+            break;
+        case file_type::DIRECTORY_TYPE:
+            contents.dir = new(slab_allocator<directory>().allocate(1))
+                    directory(*original->contents.dir);
+            contents.dir->dot = this;
+            break;
+    }
+    inode_table::enter(this);
+    DEBUGF ('i', "inode " << inode_nr << ", copy of " << original);
+}
+
+inode::~inode() {
+    inode_table::leave(this);
+    switch (type) {
+        case file_type::PLAIN_TYPE:
+            contents.file->~plain_file();
+            slab_allocator<plain_file>().deallocate(contents.file, 1);
+            break;
+        case file_type::DIRECTORY_TYPE:
+            contents.dir->~directory();
+            slab_allocator<directory>().deallocate(contents.dir, 1);
+            break;
+    }
+}
+
+inode_ptr inode::make(file_type type, inode_nr_t nr) {
+    return allocate_shared<inode>(slab_allocator<inode>(), type, nr);
+}
+
+plain_file &inode::checked_file() const {
+    if (type != file_type::PLAIN_TYPE) {
+        throw file_error("is a directory");
+    }
+    return *contents.file;
 }
 
-int inode::get_inode_nr() const {
+directory &inode::checked_directory() const {
+    if (type != file_type::DIRECTORY_TYPE) {
+        throw file_error("is a plain file");
+    }
+    return *contents.dir;
+}
+
+size_t inode::size() const {
+    switch (type) {
+        case file_type::PLAIN_TYPE:
+            return contents.file->size();
+        case file_type::DIRECTORY_TYPE:
+            return contents.dir->size();
+    }
+    return 0;
+}
+
+const string &inode::readfile() const {
+    return checked_file().readfile();
+}
+
+void inode::writefile(const wordvec &newdata) {
+    checked_file().writefile(newdata);
+    reindex();
+}
+
+void inode::truncate() {
+    checked_file().truncate();
+}
+
+bool inode::append(string_view text, bool joined) {
+    return checked_file().append(text, joined);
+}
+
+void inode::reindex() {
+    directory *parent = checked_file().get_parent();
+    if (parent != nullptr and parent->located) {
+        word_index::write(this);
+    }
+}
+
+void inode::remove(string_view filename) {
+    checked_directory().remove(filename);
+}
+
+inode_ptr inode::mkdir(string_view dirname) {
+    return checked_directory().mkdir(dirname);
+}
+
+inode_ptr inode::mkfile(string_view filename) {
+    return checked_directory().mkfile(filename);
+}
+
+inode_nr_t inode::get_inode_nr() const {
     DEBUGF ('i', "inode = " << inode_nr);
     return inode_nr;
 }
 
+vector<inode_table::slot> &inode_table::slots() {
+    static vector<slot> table;
+    return table;
+}
 
-file_error::file_error(const string &what) :
-        runtime_error(what) {
+vector<inode *> &inode_table::aside() {
+    static vector<inode *> provisional;
+    return provisional;
+}
+
+mutex &inode_table::lock() {
+    static mutex table_lock;
+    return table_lock;
 }
 
-size_t plain_file::size() const {
-    uint i = 0;
-    if (this->data.size() == 0) {
-        return 0;
+void inode_table::enter(inode *node) {
+    size_t nr = node->get_inode_nr();
+    if (nr >= inode_numbers::PROVISIONAL) {
+        aside()[nr - inode_numbers::PROVISIONAL] = node;
+        return;
     }
-    for (string s: this->data) {
-        i += s.size();
+    guard<mutex> held(lock());
+    auto &table = slots();
+    if (nr >= table.size()) {
+        table.resize(max(nr + 1, table.size() * 2));
     }
-    i += this->data.size() - 1;
-    return size_t{i};
+    ++table[nr].versions;
+    revive(node);
 }
 
-const wordvec &plain_file::readfile() const {
-    DEBUGF ('i', data);
-    return data;
+void inode_table::leave(const inode *node) {
+    size_t nr = node->get_inode_nr();
+    if (nr >= inode_numbers::PROVISIONAL) {
+        aside()[nr - inode_numbers::PROVISIONAL] = nullptr;
+        return;
+    }
+    guard<mutex> held(lock());
+    auto &table = slots();
+    auto &entry = table[nr];
+    if (entry.node == node) {
+        entry.node = nullptr;
+        --live;
+    }
+    if (--entry.versions == 0) {
+        inode_numbers::release(nr);
+    }
 }
 
-void plain_file::writefile(const wordvec &words) {
-    DEBUGF ('i', words);
-    for (uint i = 2; i < words.size(); ++i) {
-        data.push_back(words[i]);
+void inode_table::set_aside(size_t count) {
+    aside().assign(count, nullptr);
+}
+
+void inode_table::settle(size_t index) {
+    inode *node = aside()[index];
+    if (node == nullptr) {
+        return;
     }
+    inode_nr_t provisional = node->inode_nr;
+    node->inode_nr = inode_numbers::allocate();
+    aside()[index] = nullptr;
+    enter(node);
+    word_index::renumber(provisional, node->inode_nr);
+}
 
+inode *inode_table::find(inode_nr_t inode_nr) {
+    auto &table = slots();
+    return inode_nr < table.size() ? table[inode_nr].node : nullptr;
 }
 
-const wordvec &plain_file::get_data() {
-    return this->data;
+size_t inode_table::size() {
+    return live;
 }
 
-void plain_file::remove(const string &) {
-    throw file_error("is a plain file");
+void inode_table::clear() {
+    for (auto &entry: slots()) {
+        entry.node = nullptr;
+    }
+    live = 0;
 }
 
-void plain_file::mkdir(inode_ptr , const string &) {
-    throw file_error("is a plain file");
+void inode_table::revive(inode *node) {
+    auto &entry = slots()[node->get_inode_nr()];
+    if (entry.node == nullptr) {
+        ++live;
+    }
+    entry.node = node;
 }
 
-inode_ptr plain_file::mkfile(const string &) {
-    throw file_error("is a plain file");
+unordered_map<uint32_t, unordered_set<inode *>> &name_index::names() {
+    static unordered_map<uint32_t, unordered_set<inode *>> names_;
+    return names_;
+}
 
+mutex &name_index::lock() {
+    static mutex index_lock;
+    return index_lock;
 }
 
+void name_index::add(fname name, inode *node) {
+    guard<mutex> held(lock());
+    if (names()[name.id()].insert(node).second) {
+        ++count;
+    }
+}
 
-size_t directory::size() const {
-    return this->dirents.size();
+void name_index::drop(fname name, inode *node) {
+    guard<mutex> held(lock());
+    auto found = names().find(name.id());
+    if (found == names().end()) {
+        return;
+    }
+    count -= found->second.erase(node);
+    if (found->second.empty()) {
+        names().erase(found);
+    }
 }
 
-map<string, inode_ptr> &directory::get_dirents() {
-    return this->dirents;
+vector<inode *> name_index::find(string_view name) {
+    fname key = fname::lookup(name);
+    auto found = key.valid() ? names().find(key.id()) : names().end();
+    if (found == names().end()) {
+        return {};
+    }
+    return {found->second.begin(), found->second.end()};
 }
 
-const wordvec &directory::readfile() const {
-    throw file_error("is a directory");
+void name_index::clear() {
+    for (auto &entry: names()) {
+        for (inode *node: entry.second) {
+            auto dir = node->get_directory();
+            if (dir != nullptr) {
+                dir->located = false;
+            }
+        }
+    }
+    names().clear();
+    count = 0;
 }
 
-void directory::writefile(const wordvec &) {
-    throw file_error("is a directory");
+file_error::file_error(const string &what) :
+        runtime_error(what) {
 }
 
-void directory::remove(const string &filename) {
+plain_file::plain_file(const plain_file &that) :
+        base_file(), text(that.text), offsets(that.offsets) {
+}
 
-    auto inode = this->dirents.at(filename);
+const string &plain_file::readfile() const {
+    DEBUGF ('i', text);
+    return text;
+}
 
-    auto fileOrDir = dynamic_cast<directory *>(inode.get()->get_contents().get());
-    if (fileOrDir != nullptr) {
-        auto dirents1 = fileOrDir->get_dirents();
+void plain_file::writefile(const wordvec &words) {
+    DEBUGF ('i', words);
+    size_t before = text.size();
+    size_t length = text.size();
+    for (uint i = 2; i < words.size(); ++i) {
+        length += words[i].size() + 1;
+    }
+    text.reserve(length);
+    offsets.reserve(offsets.size() + words.size());
+    for (uint i = 2; i < words.size(); ++i) {
+        if (not offsets.empty()) {
+            text += ' ';
+        }
+        offsets.push_back(text.size());
+        text += words[i];
+    }
+    if (parent != nullptr and text.size() != before) {
+        parent->adjust_totals({0, 0, int64_t(text.size() - before)});
+    }
+}
 
-        dirents1["."].reset();
-        dirents1.erase(".");
+void plain_file::truncate() {
+    if (parent != nullptr and not text.empty()) {
+        parent->adjust_totals({0, 0, -int64_t(text.size())});
+    }
+    text.clear();
+    offsets.clear();
+}
 
-        dirents1[".."].reset();
-        dirents1.erase("..");
+// append -
+//    No room is reserved ahead, since a file written a chunk at a
+//    time would then grow by a chunk at a time, and the buffer would
+//    be copied once per chunk instead of once per doubling.
+
+bool plain_file::append(string_view chunk, bool joined) {
+    static constexpr string_view spaces = " \t\n";
+    size_t before = text.size();
+    size_t next = 0;
+    while (next < chunk.size()) {
+        size_t start = chunk.find_first_not_of(spaces, next);
+        if (start == string_view::npos) {
+            joined = false;
+            break;
+        }
+        size_t end = min(chunk.find_first_of(spaces, start), chunk.size());
+        if (not joined or start > 0) {
+            if (not offsets.empty()) {
+                text += ' ';
+            }
+            offsets.push_back(text.size());
+        }
+        text.append(chunk.substr(start, end - start));
+        joined = end == chunk.size();
+        next = end;
+    }
+    if (parent != nullptr and text.size() != before) {
+        parent->adjust_totals({0, 0, int64_t(text.size() - before)});
     }
+    return joined;
+}
+
+string_view plain_file::word(size_t index) const {
+    size_t start = offsets.at(index);
+    size_t end = index + 1 < offsets.size() ? offsets[index + 1] - 1
+                                            : text.size();
+    return string_view(text).substr(start, end - start);
+}
+
+
+size_t directory::size() const {
+    return this->dirents.size() + 2;
+}
 
-    inode.reset();
-    dirents.erase(filename);
+dirent_list &directory::get_dirents() {
+    return this->dirents;
 }
 
-void directory::mkdir(inode_ptr parent, const string& dirname) {
+
+void directory::remove(string_view filename) {
+    auto entry = this->dirents.find(fname::lookup(filename));
+    if (entry == this->dirents.end()) {
+        throw file_error(string(filename) + ": no such file or directory");
+    }
+    if (this->located) {
+        name_index::drop(entry->name, entry->node.get());
+    }
+    auto dir = entry->node->get_directory();
+    if (dir != nullptr) {
+        const auto &gone = dir->totals;
+        this->adjust_totals({-gone.files, -gone.dirs - 1, -gone.bytes});
+        dir->set_parent(nullptr);
+        if (dir->located) {
+            dir->unlocate();
+        }
+    } else {
+        auto file = entry->node->get_file();
+        this->adjust_totals({-1, 0, -int64_t(file->size())});
+        file->parent = nullptr;
+        if (this->located) {
+            word_index::drop(entry->node->get_inode_nr());
+        }
+    }
+    this->dirents.erase(entry);
+    this->changed();
+}
+
+inode_ptr directory::mkdir(string_view dirname) {
     DEBUGF ('i', dirname);
 
-    if (this->dirents.find(dirname) != this->dirents.end()) {
-        throw command_error(dirname + ": file or dir already exists");
+    if (dirname == "." or dirname == ".." or child(dirname) != nullptr) {
+        throw command_error(string(dirname) + ": file or dir already exists");
+    }
+    inode_ptr dir = inode::make(file_type::DIRECTORY_TYPE);
+
+    fname entry_name(dirname);
+    auto nd = dir->get_directory();
+    nd->dotdot = this->dot;
+    nd->set_name(entry_name);
+    {
+        guard<shared_mutex> held(locks::for_directory(this));
+        this->dirents.insert(entry_name, dir);
+        this->added();
     }
-    inode_ptr dir = make_shared<inode>(inode(file_type::DIRECTORY_TYPE));
+    if (this->located) {
+        nd->located = true;
+        name_index::add(entry_name, dir.get());
+    }
+    this->adjust_totals({0, 1, 0});
+    return dir;
+}
 
-    this->dirents.insert(pair<string, inode_ptr>(dirname, dir));
+directory::~directory() {
+    name_pool::release(this->name);
+
+    // Take the subtree apart one inode at a time.  A directory that
+    // is about to die has its own entries moved onto the stack first,
+    // so no destructor ever recurses into another.  An entry that
+    // survives loses its parent link only if the link was to the
+    // dying directory; one shared with a snapshot may belong to a
+    // different parent in the live tree.
+    struct doomed_entry {
+        inode_ptr node;
+        const inode *above;
+        const directory *above_dir;
+    };
+    vector<doomed_entry> doomed;
+    for (auto &entry: this->dirents) {
+        doomed.push_back({move(entry.node), this->dot, this});
+    }
+    this->dirents.clear();
+    while (not doomed.empty()) {
+        doomed_entry item = move(doomed.back());
+        doomed.pop_back();
+        auto dir = item.node->get_directory();
+        if (dir == nullptr) {
+            auto file = item.node->get_file();
+            if (file->parent == item.above_dir) {
+                file->parent = nullptr;
+            }
+            continue;
+        }
+        if (dir->dotdot == item.above) {
+            dir->set_parent(nullptr);
+        }
+        if (item.node.use_count() == 1) {
+            for (auto &entry: dir->dirents) {
+                doomed.push_back({move(entry.node), dir->dot, dir});
+            }
+            dir->dirents.clear();
+        }
+    }
+}
 
-    auto nd = dynamic_cast<directory *>(dir.get()->get_contents().get());
-    nd->dirents["."] = dir;
-    nd->dirents[".."] = parent;
-    nd->name = dirname;
+directory::directory(const directory &that) :
+        base_file(), dirents(that.dirents), name(that.name),
+        totals(that.totals) {
+    name_pool::acquire(this->name);
 }
 
-const string directory::get_name() {
-    return this->name;
+void directory::adopt_entries() {
+    for (auto &entry: this->dirents) {
+        auto dir = entry.node->get_directory();
+        if (dir == nullptr) {
+            entry.node->get_file()->parent = this;
+        } else if (dir->dotdot != this->dot) {
+            dir->set_parent(this->dot);
+        }
+    }
 }
 
+void directory::replace(const inode *original, inode_ptr copy) {
+    auto dir = original->get_directory();
+    auto entry = this->dirents.find(name_of(original));
+    if (this->located) {
+        name_index::drop(entry->name, entry->node.get());
+        name_index::add(entry->name, copy.get());
+        if (dir != nullptr) {
+            dir->located = false;
+            copy->get_directory()->located = true;
+        }
+    }
+    entry->node = move(copy);
+    this->changed();
+}
 
-const inode_ptr directory::search(wordvec pathname, inode_state &state) {
-    if (pathname.size() == 0) {
-        return state.get_cwd();
+void directory::unlocate() {
+    vector<directory *> pending{this};
+    while (not pending.empty()) {
+        directory *dir = pending.back();
+        pending.pop_back();
+        dir->located = false;
+        for (auto &entry: dir->dirents) {
+            name_index::drop(entry.name, entry.node.get());
+            auto below = entry.node->get_directory();
+            if (below != nullptr) {
+                pending.push_back(below);
+            } else {
+                word_index::drop(entry.node->get_inode_nr());
+            }
+        }
     }
-    auto cwinode = state.get_cwd();
-    auto searchnode = state.get_cwd();
-    string target = pathname.back();
-    pathname.pop_back();
-    for (uint i = 0; i < pathname.size(); ++i) {
-        auto content = searchnode.get()->get_contents();
-        auto dir = dynamic_cast<directory *>(content.get());
-        auto dirmap = dir->get_dirents();
-        try {
-            searchnode = dirmap.at(pathname.at(i));
-        } catch (exception &e) {
-            //not found
-            return nullptr;
+}
+
+void directory::set_name(fname newname) {
+    name_pool::acquire(newname);
+    name_pool::release(this->name);
+    this->name = newname;
+}
+
+const string &directory::get_name() {
+    return this->name.str();
+}
+
+void directory::set_parent(inode *parent) {
+    this->dotdot = parent;
+    this->changed();
+    this->pathname_stamp = 0;
+    ++relinks;
+}
+
+// A path is good if it was built since this directory was last
+// relinked, from the path its parent has now.  Each build stamps the
+// path afresh, so everything below a rebuilt path is rebuilt too.
+
+const string &directory::get_path() const {
+    uint64_t now = relinks;
+    if (this->pathname_checked == now) {
+        return this->pathname;
+    }
+    // Climb to the top, or to the nearest ancestor already checked
+    // since the last relink anywhere, then check on the way back down,
+    // without recursing.
+    vector<const directory *> chain;
+    for (const directory *dir = this; dir != nullptr;) {
+        chain.push_back(dir);
+        if (dir->pathname_checked == now) {
+            break;
         }
+        bool top = dir->dotdot == nullptr or dir->dotdot == dir->dot;
+        dir = top ? nullptr : dir->dotdot->get_directory();
     }
-    auto searchdir = dynamic_cast<directory *>(searchnode.get()->get_contents().get());
-    try {
-        return searchdir->get_dirents().at(target);
-    } catch (exception &e) {
-        //no target found
-        return nullptr;
+    const directory *parent = nullptr;
+    for (size_t i = chain.size(); i-- > 0; parent = chain[i]) {
+        const directory *dir = chain[i];
+        if (dir->pathname_checked == now) {
+            continue;
+        }
+        bool top = dir->dotdot == nullptr or dir->dotdot == dir->dot;
+        uint64_t above = top ? 0 : parent->pathname_stamp;
+        if (dir->pathname_stamp == 0 or dir->pathname_above != above) {
+            if (dir->dotdot == dir->dot) {
+                dir->pathname.clear();
+            } else {
+                dir->pathname = top ? "" : parent->pathname;
+                dir->pathname += '/';
+                dir->pathname += dir->name.str();
+            }
+            dir->pathname_stamp = ++generations;
+            dir->pathname_above = above;
+        }
+        dir->pathname_checked = now;
     }
+    return this->pathname;
+}
 
+inode *directory::get_parent() const {
+    return this->dotdot;
+}
 
+static thread_local vector<directory::totals_change> *totals_log{nullptr};
+
+void directory::log_totals(vector<totals_change> *log) {
+    totals_log = log;
+}
+
+void directory::apply_totals(const vector<totals_change> &log) {
+    for (const auto &change: log) {
+        change.dir->adjust_totals(change.delta);
+    }
+}
+
+void directory::adjust_totals(const subtree_totals &delta) {
+    if (totals_log != nullptr) {
+        totals_log->push_back({this, delta});
+        return;
+    }
+    for (directory *dir = this; dir != nullptr;) {
+        dir->totals.files += delta.files;
+        dir->totals.dirs += delta.dirs;
+        dir->totals.bytes += delta.bytes;
+        if (dir->dotdot == dir->dot or dir->dotdot == nullptr) {
+            break;
+        }
+        dir = dir->dotdot->get_directory();
+    }
+}
+
+inode *directory::child(string_view filename) const {
+    if (filename == ".") {
+        return this->dot;
+    }
+    if (filename == "..") {
+        return this->dotdot;
+    }
+    shared_guard held(locks::for_directory(this));
+    auto entry = this->dirents.find(filename);
+    return entry == this->dirents.end() ? nullptr : entry->node.get();
 }
 
+void directory::sort_entries() {
+    guard<shared_mutex> held(locks::for_directory(this));
+    this->dirents.sort();
+}
 
-inode_ptr directory::mkfile(const string &filename) {
+fname directory::name_of(const inode *entry) const {
+    auto dir = entry->get_directory();
+    if (dir != nullptr) {
+        return dir->name;
+    }
+    auto found = find_if(this->dirents.begin(), this->dirents.end(),
+                         [entry](const dirent_list::dirent &item) {
+        return item.node.get() == entry;
+    });
+    return found == this->dirents.end() ? fname() : found->name;
+}
+
+inode_ptr directory::lookup(string_view filename) const {
+    inode *link = child(filename);
+    return link == nullptr ? nullptr : link->shared_from_this();
+}
+
+inode_ptr directory::mkfile(string_view filename) {
     DEBUGF ('i', filename);
-    if (this->dirents.find(filename) != this->dirents.end()) {
-        throw command_error(filename + ": file or dir already exists");
+    if (filename == "." or filename == ".." or child(filename) != nullptr) {
+        throw command_error(string(filename) + ": file or dir already exists");
     }
 
-    inode_ptr file(new inode(file_type::PLAIN_TYPE));
-    this->dirents[filename] = file;
+    inode_ptr file = inode::make(file_type::PLAIN_TYPE);
+    fname entry_name(filename);
+    {
+        guard<shared_mutex> held(locks::for_directory(this));
+        this->dirents.insert(entry_name, file);
+        this->added();
+    }
+    file->get_file()->parent = this;
+    if (this->located) {
+        name_index::add(entry_name, file.get());
+        word_index::insert(file.get(), entry_name);
+    }
+    this->adjust_totals({1, 0, 0});
     return file;
 }
 
@@ -3,13 +3,21 @@
 #ifndef __INODE_H__
 #define __INODE_H__
 
+#include <atomic>
 #include <exception>
 #include <iostream>
-#include <memory>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 using namespace std;
 
+#include "dirents.h"
+#include "numbers.h"
 #include "util.h"
 
 // inode_t -
@@ -21,14 +29,38 @@ class base_file;
 class plain_file;
 class directory;
 using inode_ptr = shared_ptr<inode>;
-using base_file_ptr = shared_ptr<base_file>;
 ostream& operator<< (ostream&, file_type);
 
 
 // inode_state -
 //    A small convenient class to maintain the state of the simulated
-//    process:  the root (/), the current directory (.), and the
-//    prompt.
+//    process:  the root (/), the current directory (.), the prompt,
+//    and any named snapshots of the tree.
+// snapshot -
+//    Records the tree as it is now under the given name, replacing
+//    any earlier snapshot of that name.  Nothing is copied, so this
+//    takes constant time; instead every inode in the tree is frozen
+//    and will be copied before it is next changed.
+// restore -
+//    Makes a snapshot the live tree again, with the cwd at its root,
+//    and keeps the snapshot.  Parent links and the inode table are
+//    pointed back at the restored inodes, which takes one pass over
+//    the tree.  Returns false if there is no such snapshot.
+// get_snapshot -
+//    The root of the named snapshot, or nullptr.
+// has_snapshots -
+//    Whether any snapshot has been taken, so that some inodes may be
+//    frozen.
+// detached -
+//    Keeps alive the copy of the top of an orphaned subtree, if a
+//    change below the cwd needed one.
+// writable -
+//    The version of a live inode that may be changed.  That is the
+//    inode itself unless it is frozen, in which case it is replaced
+//    in the live tree by a copy, as is every frozen directory above
+//    it.  Frozen subtrees below are shared, not copied.  The root and
+//    the cwd follow their copies.  Every change to the tree made on
+//    behalf of a command must go through this.
 
 class inode_state {
    friend class inode;
@@ -37,6 +69,8 @@ class inode_state {
       inode_ptr root {nullptr};
       inode_ptr cwd {nullptr};
       string prompt_ {"% "};
+      map<string,inode_ptr> snapshots;
+      inode_ptr detached {nullptr};
    public:
       inode_state (const inode_state&); // copy ctor
       inode_state& operator= (const inode_state&) = delete; // op=
@@ -46,117 +80,541 @@ class inode_state {
       const inode_ptr& get_root() const;
       const string& prompt() const;
       void set_prompt(const string&);
+      void snapshot (const string& name);
+      bool restore (const string& name);
+      inode_ptr get_snapshot (const string& name) const;
+      bool has_snapshots() const { return not snapshots.empty(); }
+      inode_ptr writable (const inode_ptr& node);
 };
 
 // class inode -
 // inode ctor -
-//    Create a new inode of the given type.
+//    Create a new inode of the given type, or a copy of an existing
+//    inode that carries the same number.  A copy's entries are the
+//    same inodes as the original's.
+// make -
+//    Create a new inode of the given type in the slab pools, with
+//    its reference counts in the same block.  This is how inodes
+//    should be created; the contents are pooled the same way.  The
+//    number is a fresh one unless given, as it is for the root.
 // get_inode_nr -
-//    Retrieves the serial number of the inode.  Inode numbers are
-//    allocated in sequence by small integer.
+//    Retrieves the serial number of the inode.  Inode numbers come
+//    from inode_numbers and are reused once no inode carries them.
+// get_type -
+//    The type the inode was created with.  It never changes.
+// frozen -
+//    Whether the inode may be shared with a snapshot.  An inode is
+//    frozen once a snapshot has been taken since it was created, and
+//    must then not be changed.  See inode_state::writable.
+// get_file, get_directory -
+//    The contents, if the inode is of that type, or else nullptr.
+//    The type is a field of the inode, so this needs no RTTI.
 // size -
 //    Returns the size of an inode.  For a directory, this is the
 //    number of dirents.  For a text file, the number of characters
 //    when printed (the sum of the lengths of each word, plus the
 //    number of words.
+// readfile, writefile, remove, mkdir, mkfile -
+//    Forward to the contents, throwing a file_error if the inode is
+//    not of the type that supports the operation.
+// truncate, append -
+//    Forward to the file in the same way, but leave the word_index
+//    as it was, so that text can be appended a chunk at a time
+//    without indexing the file again after each.  Call reindex once
+//    the writing is done.
+// reindex -
+//    Indexes the words of a file again, if its directory is located.
 //    
 
-class inode {
+class inode: public enable_shared_from_this<inode> {
    friend class inode_state;
+   friend class inode_table;
+   private:
+      static uint32_t epoch_now;
+      inode_nr_t inode_nr;
+      uint32_t epoch;
+      file_type type;
+      union {
+         plain_file* file;
+         directory* dir;
+      } contents;
+      plain_file& checked_file() const;
+      directory& checked_directory() const;
+   public:
+      inode (file_type, inode_nr_t);
+      explicit inode (const inode* original);
+      inode (const inode&) = delete;
+      inode& operator= (const inode&) = delete;
+      ~inode();
+      static inode_ptr make (file_type,
+                             inode_nr_t = inode_numbers::allocate());
+      inode_nr_t get_inode_nr() const;
+      file_type get_type() const { return type; }
+      bool frozen() const { return epoch != epoch_now; }
+      plain_file* get_file() const {
+         return type == file_type::PLAIN_TYPE ? contents.file : nullptr;
+      }
+      directory* get_directory() const {
+         return type == file_type::DIRECTORY_TYPE ? contents.dir
+                                                  : nullptr;
+      }
+      size_t size() const;
+      const string& readfile() const;
+      void writefile (const wordvec& newdata);
+      void truncate();
+      bool append (string_view text, bool joined);
+      void reindex();
+      void remove (string_view filename);
+      inode_ptr mkdir (string_view dirname);
+      inode_ptr mkfile (string_view filename);
+};
+
+// class inode_table -
+//    Maps inode numbers onto the live inodes that carry them.  An
+//    inode enters itself when it is constructed and leaves when it is
+//    destroyed; the table does not own anything.  A copy made for
+//    copy on write takes over its original's entry.  The table also
+//    counts the inodes carrying each number, originals and copies
+//    alike, and frees the number when the last of them leaves.
+//    Entering and leaving take a lock while the tree is threaded,
+//    except for inodes with provisional numbers.
+// set_aside -
+//    Makes room for count inodes with the provisional numbers from
+//    PROVISIONAL up.  Until they are settled, those enter a slot of
+//    their own, which takes no lock, since only the thread making
+//    the inode touches it, and they are not yet live.
+// settle -
+//    Gives the inode in the slot set aside at index, if there is one,
+//    a number allocated now, and enters it under that number.  The
+//    word_index is told of the change.  Called in order of index, on
+//    one thread, settling makes the numbers come out as they would
+//    have if each inode had been given one as it was made.
+// clear, revive -
+//    Forgets which inodes are live, and then makes each inode of a
+//    restored snapshot live again, without counting it twice.
+// find -
+//    Returns the inode with that number, or nullptr if there is none.
+// size -
+//    The number of live inodes.
+
+class inode_table {
+   private:
+      struct slot {
+         inode* node {nullptr};
+         size_t versions {0};
+      };
+      static vector<slot>& slots();
+      static vector<inode*>& aside();
+      static mutex& lock();
+      static size_t live;
+   public:
+      static void enter (inode*);
+      static void leave (const inode*);
+      static void set_aside (size_t count);
+      static void settle (size_t index);
+      static inode* find (inode_nr_t inode_nr);
+      static size_t size();
+      static void clear();
+      static void revive (inode*);
+};
+
+// class name_index -
+//    Maps each name onto the inodes in the live tree that have it, so
+//    finding them takes no walk.  Directories keep it up to date as
+//    entries are made, removed or replaced by copies, and removing a
+//    directory drops everything below it.  Only the entries of located
+//    directories are indexed, which keeps snapshots and orphans out.
+//    The root has no name and is not indexed.  Adding and dropping
+//    take a lock while the tree is threaded.
+// add, drop -
+//    Records or forgets that the inode has the name.
+// find -
+//    The inodes with the name, in no particular order.
+// clear -
+//    Forgets everything, and unlocates every directory it knew of.
+// size -
+//    The number of inodes indexed.
+
+class name_index {
    private:
-      static int next_inode_nr;
-      int inode_nr;
-      base_file_ptr contents;
+      static unordered_map<uint32_t, unordered_set<inode*>>& names();
+      static mutex& lock();
+      static size_t count;
    public:
-      inode (file_type);
-      int get_inode_nr() const;
-      base_file_ptr get_contents() const;
+      static void add (fname name, inode*);
+      static void drop (fname name, inode*);
+      static vector<inode*> find (string_view name);
+      static void clear();
+      static size_t size() { return count; }
 };
 
 
 // class base_file -
 // Just a base class at which an inode can point.  No data or
 // functions.  Makes the synthesized members useable only from
-// the derived classes.
+// the derived classes.  There are no virtual functions: the inode
+// knows which kind of file it holds and calls it directly.
 
 class file_error: public runtime_error {
    public:
       explicit file_error (const string& what);
 };
 
+// struct subtree_totals -
+//    The number of plain files, the number of directories, and the
+//    bytes of file contents in a subtree, not counting its top
+//    directory itself.  Also used for the change to apply to them,
+//    which is why the counts are signed.
+
+struct subtree_totals {
+   int64_t files {0};
+   int64_t dirs {0};
+   int64_t bytes {0};
+};
+
+// struct path_result -
+//    Where a pathname leads.  Node is the inode it names, or nullptr.
+//    If there is none, parent is the deepest inode that does exist on
+//    the way, and missing is the name that was not found in it, a
+//    view into the pathname.  Leaf is true if the pathname names that
+//    entry itself, so that it can be created in parent without
+//    resolving the pathname again.  A parent that is a plain file
+//    means a name came after a file.
+
+struct path_result {
+   inode* node {nullptr};
+   inode* parent {nullptr};
+   string_view missing;
+   bool leaf {false};
+};
+
 class base_file {
    protected:
       base_file() = default;
+      ~base_file() = default;
    public:
-      virtual ~base_file() = default;
       base_file (const base_file&) = delete;
       base_file& operator= (const base_file&) = delete;
-      virtual size_t size() const = 0;
-      virtual const wordvec& readfile() const = 0;
-      virtual void writefile (const wordvec& newdata) = 0;
-      virtual void remove (const string& filename) = 0;
-      virtual void mkdir (inode_ptr parent, const string& dirname) = 0;
-      virtual inode_ptr mkfile (const string& filename) = 0;
 };
 
 // class plain_file -
 // Used to hold data.
+// The words are kept in one buffer, exactly as cat prints them, each
+// separated from the next by a space, with the offset of the start
+// of each word alongside.  A word costs its characters plus five
+// bytes, rather than a separately allocated string.
 // synthesized default ctor -
-//    Default vector<string> is a an empty vector.
+//    An empty buffer holds no words.
+// copy ctor -
+//    Copies the words, for copy on write, but not the parent.
+// get_parent -
+//    The directory the file is in, or nullptr once removed.
+// size -
+//    The length of the buffer, which is the number of characters when
+//    printed.  Constant time.
 // readfile -
-//    Returns a copy of the contents of the wordvec in the file.
+//    Returns the contents of the file as printed, without copying.
 // writefile -
-//    Replaces the contents of a file with new contents.
+//    Appends the words after the command name and the filename
+//    (that is, newdata[2] onwards) to the file, and adds the bytes
+//    to the totals of the directories above it.
+// truncate -
+//    Empties the file, and takes its bytes off the totals.
+// append -
+//    Appends text as writefile appends words, taking each run of
+//    spaces, tabs and newlines as the break between two words.  Text
+//    may be cut anywhere, so if joined is true, it continues the last
+//    word rather than starting a new one.  Returns whether the text
+//    ends inside a word, which is what joined should be for the text
+//    that comes next.  The words go straight into the buffer.
+// word_count, word -
+//    The number of words, and each word as a view into the buffer.
 
 class plain_file: public base_file {
+   friend class directory;
+   friend class inode_state;
    private:
-      wordvec data;
+      string text;
+      vector<uint32_t> offsets;
+      directory* parent {nullptr};
    public:
-      virtual size_t size() const override;
-      const wordvec& get_data();
-      virtual const wordvec& readfile() const override;
-      virtual void writefile (const wordvec& newdata) override;
-      virtual void remove (const string& filename) override;
-      virtual void mkdir (inode_ptr parent, const string& dirname) override;
-      virtual inode_ptr mkfile (const string& filename) override;
+      plain_file() = default;
+      plain_file (const plain_file&);
+      directory* get_parent() const { return parent; }
+      size_t size() const { return text.size(); }
+      const string& readfile() const;
+      void writefile (const wordvec& newdata);
+      void truncate();
+      bool append (string_view chunk, bool joined);
+      size_t word_count() const { return offsets.size(); }
+      string_view word (size_t index) const;
 };
 
 // class directory -
 // Used to map filenames onto inode pointers.
+// Only the entries below a directory are owned.  Dot (.) and dotdot
+// (..) are not stored; they are synthesized from the dot and dotdot
+// links to this inode and its parent, which do not own, so a tree
+// has no reference cycles and a removed subtree is freed as soon as
+// nothing else refers to it.
+// Each directory also keeps running totals for everything below it,
+// which every change adjusts in the directory where it happens and
+// in all its ancestors.
+// While the tree is threaded, looking an entry up takes the
+// directory's lock shared, and adding one takes it alone; see
+// locks::for_directory.  Totals are not adjusted then: each thread
+// logs its changes, to be applied once the threads are done.
+// The parent links of files and directories describe the live tree
+// only.  A subtree shared with a snapshot has one parent there and
+// perhaps another in the live tree, so a snapshot is walked from its
+// root and its dotdot links are never followed.
 // default ctor -
-//    Creates a new map with keys "." and "..".
+//    Creates an empty directory.
+// copy ctor -
+//    Shares the entries of the original, for copy on write.  The
+//    copy has no dot or dotdot until it is placed in the tree.
+// dtor -
+//    Releases the subtree iteratively rather than recursively, so
+//    deep trees cannot overflow the stack.  Subdirectories that are
+//    still referred to elsewhere (say, as the cwd) are orphaned:
+//    their parent becomes nullptr and they have no dotdot.
 // remove -
 //    Removes the file or subdirectory from the current inode.
 //    Throws an file_error if this is not a directory, the file
 //    does not exist, or the subdirectory is not empty.
 //    Here empty means the only entries are dot (.) and dotdot (..).
 // mkdir -
-//    Creates a new directory under the current directory and 
-//    immediately adds the directories dot (.) and dotdot (..) to it.
-//    Note that the parent (..) of / is / itself.  It is an error
-//    if the entry already exists.
+//    Creates a new directory under the current directory and returns
+//    it.  Its dotdot (..) is this directory.  Note that the parent
+//    (..) of / is / itself.  It is an error if the entry already
+//    exists.
 // mkfile -
 //    Create a new empty text file with the given name.  Error if
 //    a dirent with that name exists.
+// get_name -
+//    The name of this directory in its parent, shared with the
+//    parent's dirent through the name_pool.
+// get_path -
+//    The absolute pathname of this directory, as pwd prints it, or
+//    the empty string for the root.  An orphan's path starts at the
+//    top of what is left of its subtree.  The path is cached, and is
+//    rebuilt from the parent's cached path only if this directory or
+//    one above it has been linked somewhere else since, so listing a
+//    tree builds each path once, and moving one subtree rebuilds only
+//    the paths in it.  Unless some directory has been relinked since
+//    the path was last checked, it is returned without looking up.
+// set_parent -
+//    Changes dotdot, which makes the cached path stale here and in
+//    everything below.
+// name_of -
+//    The name of an entry, found by scanning for it, since a plain
+//    file does not know its own name.
+// lookup, child -
+//    The inode with the given name, including dot and dotdot, or
+//    nullptr if there is none.  Child does not add a reference.
+// resolve -
+//    Follows a pathname from this directory in a single pass, looking
+//    each name up in place, and returns where it leads.  Dot (.) is
+//    skipped and dotdot (..) follows the parent link rather than being
+//    looked up.  Below a missing name the rest is taken lexically, so
+//    a/x/../b leads to a/b whether or not x exists.  The walk stops at
+//    a name after a plain file, or at dotdot of an orphan.  Nothing is
+//    copied or allocated, and nothing is thrown.  The visitor, if
+//    any, is called with each directory a name is looked up in or
+//    whose parent link is followed.
+// sort_entries -
+//    Puts the entries in lexicographic order, if adding some has left
+//    them out of it.  That moves them, so it takes the directory's
+//    lock alone, as adding an entry does.
+// for_each_entry -
+//    Calls visit (name, inode*) for every entry, dot and dotdot
+//    included, in lexicographic order, as ls prints them.  Dotdot is
+//    the parent in the live tree unless another is given.  It sorts
+//    the entries first, which is why it is not const.
+// for_each_prefixed -
+//    Calls visit (name, inode*) for every entry whose name starts with
+//    the prefix, dot and dotdot excluded, in lexicographic order.  It
+//    sorts the entries first, as for_each_entry does, then seeks
+//    straight to the first of them rather than scanning.
+// get_generation -
+//    A number that changes whenever an entry is removed or replaced,
+//    or dotdot changes: whenever a name that led somewhere might now
+//    lead somewhere else or nowhere.  Adding an entry leaves it alone.
+// get_additions -
+//    A number that changes whenever an entry is added: whenever a
+//    name that led nowhere might now lead somewhere.  Both numbers
+//    come from one counter, so no two directories ever share one.
+//    Both may be read while another thread changes them.
+// adopt_entries -
+//    Points the parent links of all the entries at this directory.
+// replace -
+//    Puts a copy in place of one of the entries.
+// located -
+//    Whether this directory is in the live tree, and so keeps its
+//    entries in the name_index.
+// unlocate -
+//    Drops everything below this directory from the name_index and
+//    the word_index, once it has left the live tree, without
+//    recursing.
+// get_inode -
+//    The inode holding this directory, which is its dot.
+// get_totals -
+//    The running totals for the subtree below this directory.
+// adjust_totals -
+//    Applies a change to the totals here and in every ancestor up to
+//    the root, or up to where an orphaned subtree was cut off, or
+//    logs it, if the calling thread has a log.
+// log_totals -
+//    Makes adjust_totals, on the calling thread only, append to the
+//    log instead, until it is set back to nullptr.  Nothing may read
+//    the totals until the log has been applied.
+// apply_totals -
+//    Applies the changes in a log.  Since they only add up, logs can
+//    be applied in any order.
 
 class directory: public base_file {
+   friend class inode;
+   friend class inode_state;
+   friend class name_index;
    private:
-      // Must be a map, not unordered_map, so printing is lexicographic
-      map<string,inode_ptr> dirents;
-      string name;
+      // Hashed when large; sorted on demand, so printing is lexicographic
+      dirent_list dirents;
+      fname name;
+      inode* dot {nullptr};
+      inode* dotdot {nullptr};
+      subtree_totals totals;
+      static atomic<uint64_t> generations;
+      atomic<uint64_t> generation {++generations};
+      atomic<uint64_t> additions {++generations};
+      static atomic<uint64_t> relinks;
+      mutable string pathname;
+      mutable uint64_t pathname_stamp {0};
+      mutable uint64_t pathname_above {0};
+      mutable uint64_t pathname_checked {0};
+      bool located {false};
+      void changed() { generation = ++generations; }
+      void added() { additions = ++generations; }
+      void unlocate();
+      void set_name (fname newname);
+      void set_parent (inode* parent);
+      void adopt_entries();
+      void replace (const inode* original, inode_ptr copy);
    public:
-      void clearDir();
-      const string get_name();
+      directory() = default;
+      directory (const directory&);
+      ~directory();
+      const string& get_name();
+      const string& get_path() const;
+      inode* get_parent() const;
+      inode* get_inode() const { return dot; }
+      uint64_t get_generation() const {
+         return generation.load (memory_order_relaxed);
+      }
+      uint64_t get_additions() const {
+         return additions.load (memory_order_relaxed);
+      }
+      inode_ptr lookup (string_view name) const;
+      inode* child (string_view name) const;
+      fname name_of (const inode* entry) const;
+      path_result resolve (string_view path) const {
+         return resolve (path, [] (const directory*) {});
+      }
+      template <typename visitor>
+      path_result resolve (string_view path, visitor visit_dir) const;
+      void sort_entries();
+      template <typename visitor>
+      void for_each_entry (visitor visit) {
+         for_each_entry (dotdot, visit);
+      }
+      template <typename visitor>
+      void for_each_entry (inode* parent, visitor visit);
+      template <typename visitor>
+      void for_each_prefixed (string_view prefix, visitor visit);
       static inode_ptr mk_root_dir();
-      virtual size_t size() const override;
-      virtual const wordvec& readfile() const override;
-      virtual void writefile (const wordvec& newdata) override;
-      virtual void remove (const string& filename) override;
-      virtual void mkdir (inode_ptr parent, const string& dirname) override;
-      virtual inode_ptr mkfile (const string& filename) override;
-       map<string,inode_ptr>& get_dirents() ;
-       const inode_ptr search(wordvec pathname, inode_state& state);
+      const subtree_totals& get_totals() const { return totals; }
+      void adjust_totals (const subtree_totals& delta);
+      struct totals_change {
+         directory* dir;
+         subtree_totals delta;
+      };
+      static void log_totals (vector<totals_change>* log);
+      static void apply_totals (const vector<totals_change>& log);
+      size_t size() const;
+      void remove (string_view filename);
+      inode_ptr mkdir (string_view dirname);
+      inode_ptr mkfile (string_view filename);
+       dirent_list& get_dirents() ;
 };
 
+template <typename visitor>
+path_result directory::resolve (string_view path,
+                                visitor visit_dir) const {
+   path_result result;
+   inode* node = dot;
+   // How many names deep the walk is below the first missing one.
+   size_t missing_depth = 0;
+   for (string_view component: path_names (path)) {
+      if (component == ".") continue;
+      if (missing_depth > 0) {
+         if (component == "..") --missing_depth;
+         else ++missing_depth;
+         continue;
+      }
+      const directory* dir = node->get_directory();
+      if (dir == nullptr) {
+         result.parent = node;
+         result.missing = component;
+         return result;
+      }
+      visit_dir (dir);
+      inode* next = component == ".." ? dir->dotdot
+                                      : dir->child (component);
+      if (next == nullptr) {
+         result.parent = node;
+         result.missing = component;
+         if (component == "..") return result;
+         missing_depth = 1;
+         continue;
+      }
+      node = next;
+   }
+   if (missing_depth == 0) return {node, nullptr, {}, false};
+   result.leaf = missing_depth == 1;
+   return result;
+}
+
+template <typename visitor>
+void directory::for_each_entry (inode* parent, visitor visit) {
+   static const string dots[] {".", ".."};
+   inode* const dot_nodes[] {dot, parent};
+   size_t next_dot = 0;
+   auto visit_dots_before = [&] (const string* limit) {
+      for (; next_dot < 2; ++next_dot) {
+         if (limit != nullptr and not (dots[next_dot] < *limit)) break;
+         if (dot_nodes[next_dot] != nullptr) {
+            visit (dots[next_dot], dot_nodes[next_dot]);
+         }
+      }
+   };
+   sort_entries();
+   for (const auto& entry: dirents) {
+      visit_dots_before (&entry.name.str());
+      visit (entry.name.str(), entry.node.get());
+   }
+   visit_dots_before (nullptr);
+}
+
+template <typename visitor>
+void directory::for_each_prefixed (string_view prefix,
+                                   visitor visit) {
+   sort_entries();
+   for (auto entry = dirents.seek (prefix); entry != dirents.end();
+        ++entry) {
+      const string& text = entry->name.str();
+      if (text.compare (0, prefix.size(), prefix) != 0) break;
+      visit (text, entry->node.get());
+   }
+}
+
 #endif
 
@@ -0,0 +1,223 @@
+// $Id$
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+#include "debug.h"
+#include "find.h"
+
+size_t find_query::threads {0};
+
+bool find_query::accepts (string_view name, const inode* node) const {
+   if (type_ and node->get_type() != *type_) return false;
+   if (relation_ != 0) {
+      uint64_t actual = node->size();
+      switch (relation_) {
+         case '+': if (actual <= size_) return false; break;
+         case '-': if (actual >= size_) return false; break;
+         default:  if (actual != size_) return false; break;
+      }
+   }
+   return not name_ or name_->matches_name (name);
+}
+
+// scan -
+//    One directory to be searched, and what searching it found: for
+//    each entry, in order, its path if it passed, and the scan of its
+//    own entries if it is a directory.  Scans are linked into a tree
+//    as they are made, and the tree is read back in order once every
+//    scan is done, whichever threads did them.
+
+struct scan;
+
+struct piece {
+   string path;
+   scan* below {nullptr};
+};
+
+struct scan {
+   directory* dir;
+   string path;
+   vector<piece> found;
+};
+
+// worker -
+//    A thread's queue of scans waiting to be done, and the scans it
+//    has made, which must not move.  The owner takes the newest scan
+//    from the back, so it works depth first; other threads steal the
+//    oldest from the front, which are nearest the top and so likely
+//    to be the most work.
+
+struct worker {
+   mutex lock;
+   deque<scan*> queue;
+   deque<scan> made;
+   size_t scanned {0};
+};
+
+// search_walk -
+//    The state shared by the threads of one search.  Pending counts
+//    the scans queued or under way; a scan counts the scans it queues
+//    before it finishes, so pending only reaches zero when all are.
+//    Queued counts only those waiting in some queue.  A thread that
+//    finds every queue empty sleeps on more until something is queued
+//    or pending reaches zero.  Whoever queues a scan wakes one only
+//    if some are asleep, so a busy walk never touches the lock.
+
+class search_walk {
+   private:
+      const find_query& query;
+      deque<worker> workers;
+      atomic<size_t> pending {0};
+      atomic<size_t> queued {0};
+      atomic<size_t> asleep {0};
+      mutex sleep_lock;
+      condition_variable more;
+      scan* take (size_t index);
+      void search (worker& self, scan& task);
+      void wake (bool everyone);
+   public:
+      search_walk (const find_query& query_, size_t nthreads):
+                   query (query_), workers (nthreads) {}
+      void start (scan& top);
+      void run (size_t index);
+};
+
+static string join (const string& path, const string& name) {
+   if (path.empty()) return name;
+   string result = path;
+   if (result.back() != '/') result += '/';
+   result += name;
+   return result;
+}
+
+void search_walk::start (scan& top) {
+   pending = 1;
+   queued = 1;
+   workers[0].queue.push_back (&top);
+}
+
+void search_walk::wake (bool everyone) {
+   lock_guard<mutex> guard (sleep_lock);
+   if (everyone) more.notify_all();
+   else more.notify_one();
+}
+
+scan* search_walk::take (size_t index) {
+   for (size_t offset = 0; offset < workers.size(); ++offset) {
+      worker& victim = workers[(index + offset) % workers.size()];
+      lock_guard<mutex> guard (victim.lock);
+      if (victim.queue.empty()) continue;
+      queued.fetch_sub (1);
+      scan* task;
+      if (offset == 0) {
+         task = victim.queue.back();
+         victim.queue.pop_back();
+      }else {
+         task = victim.queue.front();
+         victim.queue.pop_front();
+      }
+      return task;
+   }
+   return nullptr;
+}
+
+void search_walk::search (worker& self, scan& task) {
+   task.dir->for_each_prefixed ("",
+         [&] (const string& name, const inode* entry) {
+      directory* subdir = entry->get_directory();
+      bool passed = query.accepts (name, entry);
+      if (not passed and subdir == nullptr) return;
+      piece item;
+      string path = join (task.path, name);
+      if (subdir != nullptr) {
+         scan& next = self.made.emplace_back();
+         next.dir = subdir;
+         next.path = passed ? path : move (path);
+         item.below = &next;
+         pending.fetch_add (1);
+         {
+            lock_guard<mutex> guard (self.lock);
+            queued.fetch_add (1);
+            self.queue.push_back (&next);
+         }
+         if (asleep.load() > 0) wake (false);
+      }
+      if (passed) item.path = move (path);
+      task.found.push_back (move (item));
+   });
+}
+
+void search_walk::run (size_t index) {
+   worker& self = workers[index];
+   for (;;) {
+      scan* task = take (index);
+      if (task == nullptr) {
+         unique_lock<mutex> held (sleep_lock);
+         asleep.fetch_add (1);
+         more.wait (held, [this] {
+            return queued.load() > 0 or pending.load() == 0;
+         });
+         asleep.fetch_sub (1);
+         if (pending.load() == 0) break;
+         continue;
+      }
+      search (self, *task);
+      ++self.scanned;
+      if (pending.fetch_sub (1) == 1) wake (true);
+   }
+   DEBUGF ('f', "thread " << index << " scanned " << self.scanned
+           << " directories");
+}
+
+vector<string> find_query::search (const inode* start,
+                                   const string& path) const {
+   vector<string> result;
+   // Start is named by the last name in its path, if it has one.
+   string name = path;
+   size_t end = path.find_last_not_of ('/');
+   if (end != string::npos) {
+      size_t slash = path.find_last_of ('/', end);
+      size_t begin = slash == string::npos ? 0 : slash + 1;
+      name = path.substr (begin, end + 1 - begin);
+   }
+   if (accepts (name, start)) result.push_back (path);
+   directory* dir = start->get_directory();
+   if (dir == nullptr) return result;
+
+   size_t nthreads = threads != 0 ? threads
+                   : max<size_t> (1, thread::hardware_concurrency());
+   const auto& totals = dir->get_totals();
+   if (totals.files + totals.dirs < PARALLEL_MIN) nthreads = 1;
+   scan top {dir, path, {}};
+   search_walk walk (*this, nthreads);
+   walk.start (top);
+   vector<thread> helpers;
+   for (size_t index = 1; index < nthreads; ++index) {
+      helpers.emplace_back (&search_walk::run, &walk, index);
+   }
+   walk.run (0);
+   for (auto& helper: helpers) helper.join();
+
+   // Read the tree of scans back in order, without recursing, since
+   // it is as deep as the subtree.
+   vector<pair<scan*, size_t>> stack {{&top, 0}};
+   while (not stack.empty()) {
+      scan* current = stack.back().first;
+      size_t next = stack.back().second++;
+      if (next == current->found.size()) {
+         stack.pop_back();
+         continue;
+      }
+      piece& item = current->found[next];
+      if (not item.path.empty()) result.push_back (move (item.path));
+      if (item.below != nullptr) stack.emplace_back (item.below, 0);
+   }
+   return result;
+}
+
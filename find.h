@@ -0,0 +1,66 @@
+// $Id$
+
+// find -
+//    Searching a subtree for the inodes that satisfy some predicates,
+//    with the walk spread over several threads.
+
+#ifndef __FIND_H__
+#define __FIND_H__
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+#include "glob.h"
+
+// class find_query -
+//    The predicates of a find, all of which must hold.  They are
+//    tested on each entry as the walk reaches it, cheapest first, and
+//    a path is only built for an entry that passes or that has to be
+//    walked into.
+// name -
+//    The entry's name matches a pattern, as glob::matches_name.
+// type -
+//    The entry is a plain file or a directory.
+// size -
+//    The entry's size, as ls shows it, is more than ('+'), less than
+//    ('-'), or exactly (anything else) the given number.
+// search -
+//    The pathnames of every inode in the subtree under start that
+//    passes, start included, with path as the name of start.  They
+//    come in pre-order, that is, each directory just before
+//    everything below it, and the entries of a directory in
+//    lexicographic order, however many threads did the work.
+// threads -
+//    How many threads search uses, or zero for one per core.  Small
+//    subtrees are searched on the calling thread regardless.
+// PARALLEL_MIN -
+//    The fewest inodes in a subtree, by its totals, worth starting
+//    threads for.
+
+class find_query {
+   private:
+      optional<glob> name_;
+      optional<file_type> type_;
+      char relation_ {0};
+      uint64_t size_ {0};
+   public:
+      static size_t threads;
+      static constexpr int64_t PARALLEL_MIN = 4096;
+      void name (string_view pattern) { name_.emplace (pattern); }
+      void type (file_type wanted) { type_ = wanted; }
+      void size (char relation, uint64_t bound) {
+         relation_ = relation;
+         size_ = bound;
+      }
+      bool accepts (string_view name, const inode* node) const;
+      vector<string> search (const inode* start, const string& path)
+                     const;
+};
+
+#endif
+
@@ -0,0 +1,237 @@
+// $Id$
+
+#include <unordered_set>
+
+using namespace std;
+
+#include "debug.h"
+#include "glob.h"
+
+bool glob::is_pattern (string_view word) {
+   return word.find_first_of ("*?[\\") != string_view::npos;
+}
+
+glob::glob (string_view pattern) {
+   absolute = not pattern.empty() and pattern.front() == '/';
+   for (string_view name: path_names (pattern)) {
+      segment compiled = compile (name);
+      // A run of ** is the same as one, and would match twice.
+      if (compiled.what == role::RECURSE and not segments.empty()
+          and segments.back().what == role::RECURSE) continue;
+      if (compiled.what == role::RECURSE) ++recursions;
+      segments.push_back (move (compiled));
+   }
+}
+
+// compile -
+//    Turns one name of the pattern into tokens.  Adjacent literal
+//    characters make one token, a run of stars one star, and a set is
+//    kept as pairs of characters, each the ends of a range.  A [ with
+//    no ] to close it is just a [.
+
+glob::segment glob::compile (string_view name) {
+   segment result;
+   if (name == "**") {
+      result.what = role::RECURSE;
+      return result;
+   }
+   auto add = [&result] (kind what, string text) {
+      result.tokens.push_back ({what, move (text)});
+   };
+   auto add_literal = [&] (char letter) {
+      if (result.tokens.empty()
+          or result.tokens.back().what != kind::LITERAL) {
+         add (kind::LITERAL, "");
+      }
+      result.tokens.back().text += letter;
+   };
+   for (size_t pos = 0; pos < name.size(); ++pos) {
+      char letter = name[pos];
+      if (letter == '\\' and pos + 1 < name.size()) {
+         add_literal (name[++pos]);
+      }else if (letter == '*') {
+         if (result.tokens.empty()
+             or result.tokens.back().what != kind::ANY) {
+            add (kind::ANY, "");
+         }
+      }else if (letter == '?') {
+         add (kind::ONE, "");
+      }else if (letter == '[') {
+         size_t first = pos + 1;
+         bool negated = first < name.size()
+                    and (name[first] == '!' or name[first] == '^');
+         if (negated) ++first;
+         // A ] right at the start is in the set, not the end of it.
+         size_t close = name.find (']', first + 1);
+         if (first >= name.size() or close == string_view::npos) {
+            add_literal (letter);
+            continue;
+         }
+         string ranges;
+         for (size_t at = first; at < close; ++at) {
+            ranges += name[at];
+            if (at + 2 < close and name[at + 1] == '-') at += 2;
+            ranges += name[at];
+         }
+         add (negated ? kind::NOT_SET : kind::SET, move (ranges));
+         pos = close;
+      }else {
+         add_literal (letter);
+      }
+   }
+   if (result.tokens.size() == 1
+       and result.tokens[0].what == kind::LITERAL) {
+      result.what = role::NAME;
+   }else {
+      result.what = role::PATTERN;
+   }
+   if (not result.tokens.empty()
+       and result.tokens[0].what == kind::LITERAL) {
+      result.prefix = result.tokens[0].text;
+   }
+   return result;
+}
+
+// matches -
+//    Matches a name against a pattern segment, token by token.  On a
+//    mismatch the last star takes one more character and the match
+//    resumes after it, which is enough since every other token
+//    matches a fixed number of characters.
+
+bool glob::matches (const segment& seg, string_view name) {
+   bool dotted = not seg.prefix.empty() and seg.prefix[0] == '.';
+   if (name.front() == '.' and not dotted) return false;
+   const auto& tokens = seg.tokens;
+   size_t tok = 0;
+   size_t pos = 0;
+   size_t star = string::npos;
+   size_t star_pos = 0;
+   for (;;) {
+      bool advanced = false;
+      if (tok < tokens.size()) {
+         const token& item = tokens[tok];
+         switch (item.what) {
+            case kind::ANY:
+               star = tok++;
+               star_pos = pos;
+               continue;
+            case kind::LITERAL:
+               if (name.substr (pos, item.text.size()) == item.text) {
+                  pos += item.text.size();
+                  advanced = true;
+               }
+               break;
+            case kind::ONE:
+               advanced = pos < name.size();
+               if (advanced) ++pos;
+               break;
+            case kind::SET:
+            case kind::NOT_SET:
+               if (pos < name.size()) {
+                  bool in = false;
+                  for (size_t at = 0; at < item.text.size(); at += 2) {
+                     in = in or (item.text[at] <= name[pos]
+                                 and name[pos] <= item.text[at + 1]);
+                  }
+                  advanced = in == (item.what == kind::SET);
+                  if (advanced) ++pos;
+               }
+               break;
+         }
+         if (advanced) {
+            ++tok;
+            continue;
+         }
+      }else if (pos == name.size()) {
+         return true;
+      }
+      if (star == string::npos or star_pos >= name.size()) return false;
+      tok = star + 1;
+      pos = ++star_pos;
+   }
+}
+
+bool glob::matches_name (string_view name) const {
+   if (segments.size() != 1 or name.empty()) return false;
+   const segment& seg = segments[0];
+   switch (seg.what) {
+      case role::NAME: return name == seg.prefix;
+      case role::PATTERN: return matches (seg, name);
+      case role::RECURSE: return name.front() != '.';
+   }
+   return false;
+}
+
+vector<glob::match> glob::expand (const inode_state& state) const {
+   return expand (absolute ? state.get_root().get()
+                           : state.get_cwd().get());
+}
+
+vector<glob::match> glob::expand (inode* start) const {
+   vector<match> found;
+   walk (0, start, absolute ? "/" : "", found);
+   // With more than one **, the same path can match in several ways.
+   if (recursions > 1) {
+      unordered_set<const inode*> seen;
+      vector<match> unique;
+      for (auto& item: found) {
+         if (seen.insert (item.node).second) {
+            unique.push_back (move (item));
+         }
+      }
+      found = move (unique);
+   }
+   DEBUGF ('g', found.size() << " matches");
+   return found;
+}
+
+void glob::walk (size_t index, inode* node, const string& path,
+                 vector<match>& found) const {
+   if (index == segments.size()) {
+      // Only a leading ** gets here with no path, and like a shell it
+      // does not match the directory it started in.
+      if (not path.empty()) found.push_back ({path, node});
+      return;
+   }
+   directory* dir = node->get_directory();
+   if (dir == nullptr) return;
+   const segment& seg = segments[index];
+   bool last = index + 1 == segments.size();
+   auto below = [&path] (string_view name) {
+      string result = path;
+      if (not result.empty() and result.back() != '/') result += '/';
+      result += name;
+      return result;
+   };
+   switch (seg.what) {
+      case role::NAME: {
+         inode* next = dir->child (seg.prefix);
+         if (next != nullptr) {
+            walk (index + 1, next, below (seg.prefix), found);
+         }
+         break;
+      }
+      case role::PATTERN:
+         dir->for_each_prefixed (seg.prefix,
+               [&] (const string& name, inode* entry) {
+            if ((last or entry->get_directory() != nullptr)
+                and matches (seg, name)) {
+               walk (index + 1, entry, below (name), found);
+            }
+         });
+         break;
+      case role::RECURSE:
+         walk (index + 1, node, path, found);
+         dir->for_each_prefixed ("",
+               [&] (const string& name, inode* entry) {
+            if (name.front() == '.') return;
+            if (entry->get_directory() != nullptr) {
+               walk (index, entry, below (name), found);
+            }else if (last) {
+               found.push_back ({below (name), entry});
+            }
+         });
+         break;
+   }
+}
+
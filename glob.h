@@ -0,0 +1,75 @@
+// $Id$
+
+// glob -
+//    Filename patterns, as a shell expands them, matched against the
+//    tree rather than against a list of names.
+
+#ifndef __GLOB_H__
+#define __GLOB_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+
+// class glob -
+//    A pattern compiled once into one segment per name in it.
+//       *      any run of characters, including none
+//       ?      any one character
+//       [...]  any one of the characters in the set, which may hold
+//              ranges like a-z; [!...] or [^...] is any other one
+//       **     as a whole name, any number of directories, even none
+//       \c     the character c itself
+//    A wildcard does not match a leading dot, and never matches dot
+//    or dotdot; a pattern that wants them must spell the dot out.
+// is_pattern -
+//    Whether a word has any wildcard in it.  Words that do not are
+//    taken as plain pathnames and never expanded.
+// expand -
+//    Every pathname the pattern matches, in the order a depth-first
+//    walk in lexicographic order finds them, each with its inode.
+//    The walk starts at the root for an absolute pattern, or else at
+//    the start given.  A name without wildcards is looked up, not
+//    searched for; a pattern only visits the entries that start with
+//    its literal prefix; and only directories that match a segment
+//    are walked into, so subtrees that cannot match are never seen.
+// matches_name -
+//    Whether one name matches a pattern that is a single name, as for
+//    find -name.  The tree is not consulted.
+
+class glob {
+   public:
+      struct match {
+         string path;
+         inode* node;
+      };
+      static bool is_pattern (string_view word);
+      explicit glob (string_view pattern);
+      vector<match> expand (const inode_state& state) const;
+      vector<match> expand (inode* start) const;
+      bool matches_name (string_view name) const;
+   private:
+      enum class kind {LITERAL, ONE, ANY, SET, NOT_SET};
+      struct token {
+         kind what;
+         string text;
+      };
+      enum class role {NAME, PATTERN, RECURSE};
+      struct segment {
+         role what {role::NAME};
+         string prefix;
+         vector<token> tokens;
+      };
+      bool absolute {false};
+      size_t recursions {0};
+      vector<segment> segments;
+      static segment compile (string_view name);
+      static bool matches (const segment&, string_view name);
+      void walk (size_t index, inode* node, const string& path,
+                 vector<match>& found) const;
+};
+
+#endif
+
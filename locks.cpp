@@ -0,0 +1,17 @@
+// $Id$
+
+#include <cstddef>
+#include <functional>
+
+using namespace std;
+
+#include "locks.h"
+
+bool locks::threaded_ {false};
+
+shared_mutex& locks::for_directory (const void* dir) {
+   static shared_mutex table[DIRECTORY_LOCKS];
+   return table[hash<const void*>() (dir) / alignof (max_align_t)
+                % DIRECTORY_LOCKS];
+}
+
@@ -0,0 +1,82 @@
+// $Id$
+
+// locks -
+//    What makes the tree safe to change from several threads at once.
+//    Only the batch scheduler does that, and only while its workers
+//    are running.  The rest of the time no lock is taken at all, and
+//    a shell running one command at a time pays for a test of a flag.
+
+#ifndef __LOCKS_H__
+#define __LOCKS_H__
+
+#include <mutex>
+#include <shared_mutex>
+using namespace std;
+
+// class locks -
+// threaded -
+//    Whether the guards below lock anything.  It is set only while no
+//    worker is running, before they start and after they are joined.
+// for_directory -
+//    The lock for the entries of a directory.  Rather than one in
+//    every directory, there is a fixed set, and a directory uses the
+//    one its address picks.  Two directories sharing one only wait
+//    for each other now and then.
+// Lock order -
+//    A thread holding one lock takes another only in the order below,
+//    so no two threads can each hold what the other waits for.
+//    - A directory's lock, then the name_pool's: adding an entry
+//      takes a reference to its name, and looking one up finds the
+//      name in the pool.  No thread holds two directory locks.
+//    - The word_index's lock, then the name_pool's: a document takes
+//      and gives back references to the file's name.
+//    - The dentry_cache's lock, then a slab pool's: dropping an entry
+//      can free the last weak reference to an inode's control block.
+//    - The inode_table's lock, then the shared pool of inode_numbers:
+//      the last version of an inode to leave frees its number.
+//    The name_pool, the name_index, the slab pools and their list of
+//    size classes, the shared pool of numbers, and the batch itself
+//    take no other lock while they hold their own.
+
+class locks {
+   private:
+      static bool threaded_;
+   public:
+      static constexpr size_t DIRECTORY_LOCKS = 64;
+      static bool threaded() { return threaded_; }
+      static void set_threaded (bool on) { threaded_ = on; }
+      static shared_mutex& for_directory (const void* dir);
+};
+
+// guard, shared_guard -
+//    Hold a lock, or a shared lock, for their lifetime, if threaded.
+
+template <typename mutex_type>
+class guard {
+   private:
+      mutex_type* held;
+   public:
+      explicit guard (mutex_type& lock):
+               held (locks::threaded() ? &lock : nullptr) {
+         if (held != nullptr) held->lock();
+      }
+      guard (const guard&) = delete;
+      guard& operator= (const guard&) = delete;
+      ~guard() { if (held != nullptr) held->unlock(); }
+};
+
+class shared_guard {
+   private:
+      shared_mutex* held;
+   public:
+      explicit shared_guard (shared_mutex& lock):
+               held (locks::threaded() ? &lock : nullptr) {
+         if (held != nullptr) held->lock_shared();
+      }
+      shared_guard (const shared_guard&) = delete;
+      shared_guard& operator= (const shared_guard&) = delete;
+      ~shared_guard() { if (held != nullptr) held->unlock_shared(); }
+};
+
+#endif
+
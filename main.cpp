@@ -1,5 +1,6 @@
 // $Id: main.cpp,v 1.9 2016-01-14 16:16:52-08 - - $
 
+#include <cctype>
 #include <cstdlib>
 #include <iostream>
 #include <string>
@@ -8,23 +9,82 @@
 
 using namespace std;
 
+#include "batch.h"
+#include "bytecode.h"
 #include "commands.h"
 #include "debug.h"
 #include "file_sys.h"
+#include "output.h"
+#include "pipeline.h"
+#include "redirect.h"
+#include "script.h"
+#include "slab.h"
 #include "util.h"
 
 // scan_options
-//    Options analysis:  The only option is -Dflags. 
+//    Options analysis:  -@flags sets debug flags, -H backs the inode
+//    pools with huge pages, -f script runs the script in batch mode
+//    instead of reading stdin, -j workers runs the mkdir and make
+//    commands of the script on that many threads where they do not
+//    depend on each other, -u leaves output unbuffered, and
+//    -c script -o file compiles the script into the file rather than
+//    running anything.  The file defaults to the script's name with
+//    .ybc added.
 
-void scan_options (int argc, char** argv) {
+// scan_workers -
+//    The number of workers given to -j, which must be a plain decimal
+//    number from 1 to batch::MAX_WORKERS.  Anything else is reported,
+//    and the script runs on one thread.
+
+size_t scan_workers (const char* arg) {
+   char* stop = nullptr;
+   unsigned long count = isdigit (static_cast<unsigned char> (*arg))
+                       ? strtoul (arg, &stop, 10) : 0;
+   if (stop == nullptr or *stop != '\0'
+       or count < 1 or count > batch::MAX_WORKERS) {
+      complain() << "-j " << arg << ": workers must be from 1 to "
+                 << batch::MAX_WORKERS << endl;
+      return 1;
+   }
+   return count;
+}
+
+struct options {
+   string script_name;
+   string compile_name;
+   string output_name;
+   size_t workers {1};
+   bool unbuffered {false};
+};
+
+options scan_options (int argc, char** argv) {
+   options result;
    opterr = 0;
    for (;;) {
-      int option = getopt (argc, argv, "@:");
+      int option = getopt (argc, argv, "@:Hc:f:j:o:u");
       if (option == EOF) break;
       switch (option) {
          case '@':
             debugflags::setflags (optarg);
             break;
+         case 'H':
+            slab_pool::set_backing (slab_pool::backing::HUGE_PAGES);
+            break;
+         case 'c':
+            result.compile_name = optarg;
+            break;
+         case 'f':
+            result.script_name = optarg;
+            break;
+         case 'j':
+            result.workers = scan_workers (optarg);
+            break;
+         case 'o':
+            result.output_name = optarg;
+            break;
+         case 'u':
+            result.unbuffered = true;
+            break;
          default:
             complain() << "-" << static_cast<char> (option)
                        << ": invalid option" << endl;
@@ -34,6 +94,10 @@ void scan_options (int argc, char** argv) {
    if (optind < argc) {
       complain() << "operands not permitted" << endl;
    }
+   if (result.output_name.empty() and not result.compile_name.empty()) {
+      result.output_name = result.compile_name + ".ybc";
+   }
+   return result;
 }
 
 
@@ -45,16 +109,36 @@ int main (int argc, char** argv) {
    cout << boolalpha;  // Print false or true instead of 0 or 1.
    cerr << boolalpha;
    cout << argv[0] << " build " << __DATE__ << " " << __TIME__ << endl;
-   scan_options (argc, argv);
+   options opts = scan_options (argc, argv);
+   if (not opts.unbuffered) output::install();
    bool need_echo = want_echo();
+   bool interactive = isatty (STDIN_FILENO);
    inode_state state;
 
    try {
+      if (not opts.compile_name.empty()) {
+         try {
+            script input (opts.compile_name);
+            bytecode::compile (input, opts.output_name);
+         }catch (script_error& error) {
+            complain() << error.what() << endl;
+         }
+         return exit_status_message();
+      }
+      if (not opts.script_name.empty()) {
+         try {
+            script (opts.script_name).run (state, opts.workers);
+         }catch (script_error& error) {
+            complain() << error.what() << endl;
+         }
+         return exit_status_message();
+      }
       for (;;) {
          try {
             // Read a line, break at EOF, and echo print the prompt
             // if one is needed.
             cout << state.prompt();
+            if (interactive) output::flush();
             string line;
             getline (cin, line);
             if (cin.eof()) {
@@ -72,7 +156,19 @@ int main (int argc, char** argv) {
             if(words.size() == 0 or words[0].at(0) == '#'){
                 continue;
             }
+            if (redirect::is_redirected (words)) {
+               redirect::run (state, words);
+               continue;
+            }
+            if (pipeline::is_pipeline (words)) {
+               pipeline::run (state, words);
+               continue;
+            }
             command_fn fn = find_command_fn (words.at(0));
+            if (fn == nullptr) {
+               no_such_command (words.at(0));
+               continue;
+            }
             fn (state, words);
          }catch (command_error& error) {
             // If there is a problem discovered in any function, an
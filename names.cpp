@@ -0,0 +1,144 @@
+// $Id$
+
+#include <cassert>
+#include <cstdlib>
+
+using namespace std;
+
+#include "debug.h"
+#include "locks.h"
+#include "names.h"
+
+// names -
+//    Interned strings, by handle.  A deque never moves its elements,
+//    so the string_view keys of the index stay valid.  Slot 0 is the
+//    empty name, which is what a default constructed fname refers to.
+
+deque<name_pool::entry>& name_pool::names() {
+   static deque<entry> table {entry {}};
+   return table;
+}
+
+unordered_map<string_view,uint32_t>& name_pool::index() {
+   static unordered_map<string_view,uint32_t> table {
+      {names()[0].text, 0},
+   };
+   return table;
+}
+
+vector<uint32_t>& name_pool::free_ids() {
+   static vector<uint32_t> ids;
+   return ids;
+}
+
+shared_mutex& name_pool::lock() {
+   static shared_mutex table_lock;
+   return table_lock;
+}
+
+fname::fname (string_view name) {
+   guard<shared_mutex> held (name_pool::lock());
+   auto& index = name_pool::index();
+   auto found = index.find (name);
+   if (found != index.end()) {
+      id_ = found->second;
+      return;
+   }
+   auto& names = name_pool::names();
+   auto& free_ids = name_pool::free_ids();
+   if (free_ids.empty()) {
+      id_ = names.size();
+      names.push_back ({string (name)});
+   }else {
+      id_ = free_ids.back();
+      free_ids.pop_back();
+      names[id_].text.assign (name);
+   }
+   index.emplace (names[id_].text, id_);
+   DEBUGF ('n', "interned " << id_ << " = \"" << name << "\"");
+}
+
+fname fname::lookup (string_view name) {
+   shared_guard held (name_pool::lock());
+   auto& index = name_pool::index();
+   auto found = index.find (name);
+   return fname (found == index.end() ? NONE : found->second);
+}
+
+const string& fname::str() const {
+   assert (valid());
+   shared_guard held (name_pool::lock());
+   return name_pool::names()[id_].text;
+}
+
+ostream& operator<< (ostream& out, fname name) {
+   return out << name.str();
+}
+
+// acquire, release -
+//    The empty name is what unnamed objects start out with and is
+//    not counted.  The last release takes the name out of the index
+//    before its text is freed, since the key is a view of the text.
+
+void name_pool::acquire (fname name) {
+   if (name.id() == 0) return;
+   guard<shared_mutex> held (lock());
+   ++names()[name.id()].uses;
+}
+
+void name_pool::release (fname name) {
+   if (name.id() == 0) return;
+   guard<shared_mutex> held (lock());
+   entry& named = names()[name.id()];
+   assert (named.uses > 0);
+   if (--named.uses > 0) return;
+   index().erase (named.text);
+   string().swap (named.text);
+   free_ids().push_back (name.id());
+   DEBUGF ('n', "freed " << name.id());
+}
+
+// stats -
+//    A string at or below the small string capacity fits inside the
+//    string object; anything longer has its own heap block.
+
+name_pool::statistics name_pool::stats() {
+   static const size_t small_capacity = string().capacity();
+   auto heap_bytes = [] (const string& text) {
+      return text.size() > small_capacity ? text.capacity() + 1 : 0;
+   };
+   statistics result;
+   result.distinct = index().size();
+   result.reusable = free_ids().size();
+   for (const auto& name: names()) {
+      result.refs += name.uses;
+      result.pool += sizeof name + heap_bytes (name.text);
+      result.strings += name.uses
+                      * (sizeof (string) + heap_bytes (name.text));
+   }
+   using index_type = unordered_map<string_view,uint32_t>;
+   const index_type& table = index();
+   result.pool += table.bucket_count() * sizeof (void*)
+                + table.size() * (sizeof (void*)
+                                  + sizeof (index_type::value_type)
+                                  + sizeof (size_t));
+   result.pool += free_ids().capacity() * sizeof (uint32_t);
+   result.handles = result.refs * sizeof (fname);
+   return result;
+}
+
+ostream& operator<< (ostream& out,
+                     const name_pool::statistics& stats) {
+   long saved = static_cast<long> (stats.strings)
+              - static_cast<long> (stats.pool + stats.handles);
+   return out << "names: " << stats.distinct << " distinct, "
+              << stats.refs << " references, " << stats.reusable
+              << " handles free" << endl
+              << "names: " << stats.strings << " bytes as strings, "
+              << stats.pool + stats.handles << " bytes interned ("
+              << stats.pool << " pool + " << stats.handles
+              << " handles)" << endl
+              << "names: " << abs (saved) << " bytes "
+              << (saved < 0 ? "lost" : "saved");
+}
+
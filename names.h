@@ -0,0 +1,105 @@
+// $Id$
+
+// names -
+//    Process-wide table of interned filenames.  Each distinct name
+//    is stored once; directories refer to it by a small handle.
+
+#ifndef __NAMES_H__
+#define __NAMES_H__
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// class fname -
+//    A four byte handle to an interned filename.  Two handles are
+//    equal exactly when they name the same string, so equality is an
+//    integer compare.  Ordering is lexicographic on the names, which
+//    is what ls prints.
+// fname (string_view) -
+//    Interns the name if it is not in the table yet.
+// lookup -
+//    Finds an already interned name without adding it.  The result
+//    is not valid() if nobody has ever used that name, which lets a
+//    failed lookup stop before searching any directory.
+// str -
+//    The interned text.  The reference is stable for as long as
+//    some container holds the name.
+
+class fname {
+   private:
+      static constexpr uint32_t NONE = UINT32_MAX;
+      uint32_t id_ {0};
+      explicit constexpr fname (uint32_t id): id_ (id) {}
+   public:
+      constexpr fname() = default;
+      explicit fname (string_view name);
+      static fname lookup (string_view name);
+      bool valid() const { return id_ != NONE; }
+      uint32_t id() const { return id_; }
+      const string& str() const;
+      friend bool operator== (fname a, fname b) { return a.id_ == b.id_; }
+      friend bool operator!= (fname a, fname b) { return a.id_ != b.id_; }
+      friend bool operator< (fname a, fname b) {
+         return a.id_ != b.id_ and a.str() < b.str();
+      }
+};
+
+ostream& operator<< (ostream&, fname);
+
+// class name_pool -
+//    Owns the interned strings.  Containers that keep a handle call
+//    acquire when they store it and release when they drop it, so
+//    the pool knows how many references each name has and can report
+//    how much memory the handles save over owning strings.  When the
+//    last reference to a name is released, its string is freed and
+//    its handle goes on a free list, to be given to the next new name,
+//    so a script that keeps making and removing files under new names
+//    does not grow the table.  A handle must not be used once the
+//    reference it came with has been released.  The table is under a
+//    lock while the tree is threaded.  Interning and counting take it
+//    alone; lookup and str share it.
+// statistics -
+//    distinct  - number of interned names.
+//    reusable  - number of handles on the free list.
+//    refs      - number of live handles held by containers.
+//    pool      - bytes used by the table itself.
+//    handles   - bytes used by the live handles.
+//    strings   - bytes the same references would use as strings.
+
+class name_pool {
+   friend class fname;
+   public:
+      struct statistics {
+         size_t distinct {0};
+         size_t reusable {0};
+         size_t refs {0};
+         size_t pool {0};
+         size_t handles {0};
+         size_t strings {0};
+      };
+   private:
+      struct entry {
+         string text;
+         size_t uses {0};
+      };
+      static deque<entry>& names();
+      static unordered_map<string_view,uint32_t>& index();
+      static vector<uint32_t>& free_ids();
+      static shared_mutex& lock();
+   public:
+      static void acquire (fname);
+      static void release (fname);
+      static statistics stats();
+};
+
+ostream& operator<< (ostream&, const name_pool::statistics&);
+
+#endif
+
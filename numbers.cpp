@@ -0,0 +1,122 @@
+// $Id$
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+#include "debug.h"
+#include "numbers.h"
+
+// shared_pool -
+//    The numbers no thread holds: everything from next upwards, and
+//    those freed ones that threads have given back.  The count of
+//    freed numbers can be read without the lock, so that a thread
+//    need not take it just to find there are none.
+
+struct shared_pool {
+   atomic<inode_nr_t> next {inode_numbers::ROOT + 1};
+   atomic<size_t> nfree {0};
+   mutex lock;
+   vector<inode_nr_t> free;
+   void give_back (const inode_nr_t* begin, const inode_nr_t* end);
+};
+
+void shared_pool::give_back (const inode_nr_t* begin,
+                             const inode_nr_t* end) {
+   lock_guard<mutex> guard (lock);
+   free.insert (free.end(), begin, end);
+   nfree.store (free.size(), memory_order_relaxed);
+}
+
+static shared_pool& shared() {
+   static shared_pool pool;
+   return pool;
+}
+
+// local_batch -
+//    The numbers one thread holds: the fresh range [next, end), and
+//    the freed numbers on its own list, which are used first.
+
+struct local_batch {
+   inode_nr_t next {0};
+   inode_nr_t end {0};
+   vector<inode_nr_t> free;
+   local_batch() = default;
+   local_batch (const local_batch&) = delete;
+   local_batch& operator= (const local_batch&) = delete;
+   ~local_batch();
+   void refill();
+};
+
+local_batch::~local_batch() {
+   for (; next != end; ++next) free.push_back (next);
+   if (not free.empty()) {
+      shared().give_back (free.data(), free.data() + free.size());
+   }
+}
+
+void local_batch::refill() {
+   auto& pool = shared();
+   if (pool.nfree.load (memory_order_relaxed) > 0) {
+      lock_guard<mutex> guard (pool.lock);
+      size_t count = min (pool.free.size(), inode_numbers::BATCH);
+      free.assign (pool.free.end() - count, pool.free.end());
+      pool.free.resize (pool.free.size() - count);
+      pool.nfree.store (pool.free.size(), memory_order_relaxed);
+      if (count > 0) return;
+   }
+   next = pool.next.fetch_add (inode_numbers::BATCH);
+   end = next + inode_numbers::BATCH;
+   DEBUGF ('n', "fresh range " << next << " to " << end);
+}
+
+static local_batch& local() {
+   thread_local local_batch batch;
+   return batch;
+}
+
+static thread_local inode_nr_t (*source_fn)() {nullptr};
+
+void inode_numbers::set_source (inode_nr_t (*source)()) {
+   source_fn = source;
+}
+
+inode_nr_t inode_numbers::allocate() {
+   if (source_fn != nullptr) return source_fn();
+   auto& batch = local();
+   if (batch.free.empty() and batch.next == batch.end) batch.refill();
+   if (batch.free.empty()) return batch.next++;
+   inode_nr_t number = batch.free.back();
+   batch.free.pop_back();
+   return number;
+}
+
+void inode_numbers::release (inode_nr_t number) {
+   if (number == ROOT) return;
+   auto& batch = local();
+   batch.free.push_back (number);
+   if (batch.free.size() >= 2 * BATCH) {
+      auto keep = batch.free.end() - BATCH;
+      shared().give_back (&*keep, &*keep + BATCH);
+      batch.free.erase (keep, batch.free.end());
+   }
+}
+
+inode_numbers::statistics inode_numbers::stats() {
+   const auto& batch = local();
+   auto& pool = shared();
+   statistics result;
+   result.issued = pool.next.load() - 1 - (batch.end - batch.next);
+   result.free = pool.nfree.load() + batch.free.size();
+   return result;
+}
+
+ostream& operator<< (ostream& out,
+                     const inode_numbers::statistics& stats) {
+   return out << "numbers: " << stats.issued << " issued, "
+              << stats.free << " free for reuse";
+}
+
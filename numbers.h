@@ -0,0 +1,62 @@
+// $Id$
+
+// numbers -
+//    Inode numbers.  They are 64 bits wide, so a long running process
+//    that creates and removes files cannot run out of them, and freed
+//    numbers are used again, so they stay small and dense enough to
+//    index the inode table directly.
+
+#ifndef __NUMBERS_H__
+#define __NUMBERS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+using namespace std;
+
+using inode_nr_t = uint64_t;
+
+// class inode_numbers -
+//    Allocates inode numbers and takes them back, safely from any
+//    number of threads.  Each thread keeps a batch of numbers of its
+//    own, either a fresh range or numbers freed earlier, and only
+//    goes to the shared pool, under a lock, when the batch runs out
+//    or when it holds too many freed numbers.  A thread's batch goes
+//    back to the shared pool when the thread exits.
+// ROOT -
+//    The number of the root directory.  It is never allocated and
+//    never freed, so every root is inode 1.
+// PROVISIONAL -
+//    Numbers from here up are never allocated.  They stand in for a
+//    number an inode is to be given later; see batch.
+// allocate -
+//    A number not in use, preferring freed ones to fresh ones.
+// release -
+//    Returns a number for reuse.
+// set_source -
+//    Makes allocate, on the calling thread only, return whatever the
+//    function returns instead, until it is set back to nullptr.
+// stats -
+//    How many fresh numbers have been handed out, counting the whole
+//    of other threads' batches, and how many freed numbers are ready
+//    for reuse in the shared pool and in the calling thread.
+
+class inode_numbers {
+   public:
+      struct statistics {
+         inode_nr_t issued {0};
+         size_t free {0};
+      };
+      static constexpr inode_nr_t ROOT = 1;
+      static constexpr inode_nr_t PROVISIONAL = inode_nr_t {1} << 63;
+      static constexpr size_t BATCH = 64;
+      static inode_nr_t allocate();
+      static void release (inode_nr_t number);
+      static void set_source (inode_nr_t (*source)());
+      static statistics stats();
+};
+
+ostream& operator<< (ostream&, const inode_numbers::statistics&);
+
+#endif
+
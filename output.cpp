@@ -0,0 +1,46 @@
+// $Id$
+
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+#include "output.h"
+
+output* output::installed {nullptr};
+
+// install -
+//    The sink is never destroyed, so that nothing written to cout
+//    late in the exit sequence can find it gone.
+
+void output::install() {
+   if (installed != nullptr) return;
+   installed = new output();
+   cout.rdbuf (installed);
+   atexit (flush);
+}
+
+void output::flush() {
+   if (installed != nullptr) installed->sink::flush();
+}
+
+// write_all -
+//    A write can be cut short by a signal or write less than asked,
+//    so it goes round until done.  If output has failed for good,
+//    there is nowhere to report it.
+
+static void write_all (const char* next, const char* end) {
+   while (next < end) {
+      ssize_t written = write (STDOUT_FILENO, next, end - next);
+      if (written < 0) {
+         if (errno == EINTR) continue;
+         break;
+      }
+      next += written;
+   }
+}
+
+void output::drain (const char* begin, const char* end) {
+   write_all (begin, end);
+}
@@ -0,0 +1,46 @@
+// $Id$
+
+// output -
+//    The shell's standard output, gathered into a large buffer and
+//    written with as few system calls as possible.
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <cstddef>
+using namespace std;
+
+#include "sink.h"
+
+// class output -
+//    The sink for cout that writes to file descriptor 1 only when its
+//    chunk fills, or when told to.  Commands keep writing endl, but
+//    the flush that endl asks for does nothing here, so lsr of a big
+//    tree makes one write per chunk rather than one per line.  The
+//    bytes written are exactly those cout would have written, in the
+//    same order.
+// install -
+//    Puts the sink under cout, and has it flushed at exit.  Until it
+//    is called, and if it never is, as with -u, cout flushes at every
+//    endl as before.
+// flush -
+//    Writes out whatever is buffered.  Main calls it before reading
+//    input from a terminal, so that the prompt shows, and at exit;
+//    complain calls it before writing to cerr, so that output and
+//    errors stay in order when they go to the same place.
+// BUFFER_SIZE -
+//    How much is gathered before it is written.
+
+class output: public sink {
+   public:
+      static constexpr size_t BUFFER_SIZE = 1 << 16;
+      static void install();
+      static void flush();
+   protected:
+      void drain (const char* begin, const char* end) override;
+   private:
+      output(): sink (BUFFER_SIZE) {}
+      static output* installed;
+};
+
+#endif
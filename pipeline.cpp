@@ -0,0 +1,354 @@
+// $Id$
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+#include "commands.h"
+#include "debug.h"
+#include "pipeline.h"
+#include "sink.h"
+
+// channel -
+//    A bounded queue of batches of lines between two stages.  Lines
+//    go in batches so that the stages do not take a lock per line.
+//    Either end can close it: the writer when it has no more, after
+//    which the reader drains what is left, and the reader when it
+//    wants no more, after which every push fails at once.
+
+class channel {
+   private:
+      static constexpr size_t CAPACITY = 4;
+      mutex lock;
+      condition_variable changed;
+      deque<vector<string>> batches;
+      bool writing {true};
+      bool reading {true};
+   public:
+      bool push (vector<string>& batch) {
+         unique_lock<mutex> guard (lock);
+         changed.wait (guard, [this] {
+            return batches.size() < CAPACITY or not reading;
+         });
+         if (not reading) return false;
+         batches.push_back (move (batch));
+         changed.notify_all();
+         return true;
+      }
+      bool pop (vector<string>& batch) {
+         unique_lock<mutex> guard (lock);
+         changed.wait (guard, [this] {
+            return not batches.empty() or not writing;
+         });
+         if (batches.empty()) return false;
+         batch = move (batches.front());
+         batches.pop_front();
+         changed.notify_all();
+         return true;
+      }
+      void close_write() {
+         lock_guard<mutex> guard (lock);
+         writing = false;
+         changed.notify_all();
+      }
+      void close_read() {
+         lock_guard<mutex> guard (lock);
+         reading = false;
+         batches.clear();
+         changed.notify_all();
+      }
+};
+
+// line_source -
+//    The reading end of a channel, a line at a time.
+
+class line_source {
+   private:
+      channel& input;
+      vector<string> batch;
+      size_t next {0};
+   public:
+      explicit line_source (channel& input_): input (input_) {}
+      bool get (string& line) {
+         while (next == batch.size()) {
+            batch.clear();
+            next = 0;
+            if (not input.pop (batch)) return false;
+         }
+         line = move (batch[next++]);
+         return true;
+      }
+      void close() { input.close_read(); }
+};
+
+// line_sink -
+//    Where a stage writes its lines: the next channel, or the output
+//    of the shell for the last stage.  Put returns false once nobody
+//    is reading any more.
+
+class line_sink {
+   private:
+      static constexpr size_t BATCH = 64;
+      channel* output;
+      ostream* stream;
+      vector<string> batch;
+   public:
+      explicit line_sink (channel* output_, ostream* stream_):
+               output (output_), stream (stream_) {}
+      bool put (string line) {
+         if (output == nullptr) {
+            *stream << line << "\n";
+            return true;
+         }
+         batch.push_back (move (line));
+         return batch.size() < BATCH or flush();
+      }
+      bool flush() {
+         if (output == nullptr or batch.empty()) return true;
+         bool open = output->push (batch);
+         batch.clear();
+         return open;
+      }
+      void finish() {
+         flush();
+         if (output != nullptr) output->close_write();
+      }
+};
+
+// pipe_closed, line_buffer -
+//    The sink put under cout while the first stage runs.  It cuts
+//    each chunk into lines, and throws pipe_closed out of the write
+//    that finds the next stage has stopped reading.  The chunks are
+//    small, so that a command learns of that soon after.
+
+class pipe_closed: public exception {};
+
+class line_buffer: public sink {
+   private:
+      static constexpr size_t CHUNK_SIZE = 1 << 12;
+      line_sink& lines;
+      string line;
+      void put_line() {
+         if (not lines.put (move (line))) throw pipe_closed();
+         line.clear();
+      }
+   protected:
+      void drain (const char* begin, const char* end) override {
+         while (begin != end) {
+            auto newline = static_cast<const char*> (
+                           memchr (begin, '\n', end - begin));
+            if (newline == nullptr) {
+               line.append (begin, end);
+               break;
+            }
+            line.append (begin, newline);
+            put_line();
+            begin = newline + 1;
+         }
+      }
+   public:
+      explicit line_buffer (line_sink& lines_):
+               sink (CHUNK_SIZE), lines (lines_) {}
+      void finish() {
+         try {
+            flush();
+         }catch (pipe_closed&) {
+            line.clear();
+         }
+         if (not line.empty()) lines.put (move (line));
+         lines.finish();
+      }
+};
+
+// filters -
+//    Each reads its input to the end or until it has what it needs,
+//    and stops early if its own output closes.
+
+using filter_fn = void (*) (const wordvec& args, line_source& in,
+                            line_sink& out);
+
+static void filter_head (const wordvec& args, line_source& in,
+                         line_sink& out) {
+   size_t count = 10;
+   if (args.size() > 2 or (args.size() == 2
+       and (args[1].empty() or args[1].size() > 18
+            or args[1].find_first_not_of ("0123456789")
+               != string::npos))) {
+      throw command_error ("head: invalid count\n");
+   }
+   if (args.size() == 2) count = stoull (args[1]);
+   string line;
+   for (; count > 0 and in.get (line); --count) {
+      if (not out.put (move (line))) return;
+   }
+}
+
+static void filter_grep (const wordvec& args, line_source& in,
+                         line_sink& out) {
+   bool invert = args.size() == 3 and args[1] == "-v";
+   if (args.size() != (invert ? 3 : 2)) {
+      throw command_error ("grep: invalid number of parameters\n");
+   }
+   const string& word = args.back();
+   string line;
+   while (in.get (line)) {
+      if ((line.find (word) != string::npos) == invert) continue;
+      if (not out.put (move (line))) return;
+   }
+}
+
+static void filter_sort (const wordvec& args, line_source& in,
+                         line_sink& out) {
+   bool reverse = args.size() == 2 and args[1] == "-r";
+   if (args.size() != (reverse ? 2 : 1)) {
+      throw command_error ("sort: invalid option\n");
+   }
+   vector<string> lines;
+   string line;
+   while (in.get (line)) lines.push_back (move (line));
+   if (reverse) {
+      sort (lines.begin(), lines.end(), greater<string>());
+   }else {
+      sort (lines.begin(), lines.end());
+   }
+   for (auto& item: lines) {
+      if (not out.put (move (item))) return;
+   }
+}
+
+static void filter_wc (const wordvec& args, line_source& in,
+                       line_sink& out) {
+   if (args.size() != 1) {
+      throw command_error ("wc: invalid number of parameters\n");
+   }
+   size_t lines = 0;
+   size_t words = 0;
+   size_t bytes = 0;
+   string line;
+   while (in.get (line)) {
+      ++lines;
+      bytes += line.size() + 1;
+      words += split (line, " \t").size();
+   }
+   ostringstream counts;
+   counts << setw (7) << lines << " " << setw (7) << words << " "
+          << setw (7) << bytes;
+   out.put (counts.str());
+}
+
+static filter_fn find_filter (const string& name) {
+   if (name == "head") return filter_head;
+   if (name == "grep") return filter_grep;
+   if (name == "sort") return filter_sort;
+   if (name == "wc") return filter_wc;
+   return nullptr;
+}
+
+bool pipeline::is_pipeline (const wordvec& words) {
+   return any_of (words.begin(), words.end(), [] (const string& word) {
+      return word.find ('|') != string::npos;
+   });
+}
+
+// stages -
+//    Cuts the words at each |, which need not have spaces round it.
+
+static vector<wordvec> stages (const wordvec& words) {
+   vector<wordvec> result (1);
+   for (const string& word: words) {
+      size_t start = 0;
+      for (;;) {
+         size_t bar = min (word.find ('|', start), word.size());
+         if (bar > start) {
+            result.back().push_back (word.substr (start, bar - start));
+         }
+         if (bar == word.size()) break;
+         result.emplace_back();
+         start = bar + 1;
+      }
+   }
+   return result;
+}
+
+void pipeline::run (inode_state& state, const wordvec& words) {
+   vector<wordvec> parts = stages (words);
+   if (any_of (parts.begin(), parts.end(),
+               [] (const wordvec& part) { return part.empty(); })) {
+      throw command_error ("|: missing command\n");
+   }
+   command_fn first = find_command_fn (parts[0][0]);
+   if (first == nullptr) {
+      no_such_command (parts[0][0]);
+      return;
+   }
+   vector<filter_fn> filters;
+   for (size_t index = 1; index < parts.size(); ++index) {
+      filters.push_back (find_filter (parts[index][0]));
+      if (filters.back() == nullptr) {
+         throw command_error (parts[index][0] + ": not a filter\n");
+      }
+   }
+
+   // Channel i runs from stage i to stage i + 1.  The last filter
+   // writes to where cout was going, through an ostream of its own,
+   // since cout itself now feeds the first channel.
+   deque<channel> channels (filters.size());
+   ostream shell_out (cout.rdbuf());
+   vector<string> errors (filters.size());
+   vector<thread> threads;
+   for (size_t index = 0; index < filters.size(); ++index) {
+      threads.emplace_back ([&, index] {
+         line_source in (channels[index]);
+         bool last = index + 1 == filters.size();
+         line_sink out (last ? nullptr : &channels[index + 1],
+                        &shell_out);
+         try {
+            filters[index] (parts[index + 1], in, out);
+         }catch (command_error& error) {
+            errors[index] = error.what();
+         }
+         in.close();
+         out.finish();
+      });
+   }
+
+   line_sink lines (&channels[0], nullptr);
+   line_buffer buffer (lines);
+   streambuf* saved = cout.rdbuf (&buffer);
+   auto saved_exceptions = cout.exceptions();
+   cout.exceptions (ios::badbit);
+   exception_ptr failure;
+   string error;
+   try {
+      first (state, parts[0]);
+      buffer.finish();
+   }catch (pipe_closed&) {
+      DEBUGF ('c', parts[0][0] << ": pipe closed");
+      lines.finish();
+   }catch (command_error& caught) {
+      error = caught.what();
+      buffer.finish();
+   }catch (...) {
+      failure = current_exception();
+      buffer.finish();
+   }
+   cout.exceptions (saved_exceptions);
+   cout.clear();
+   cout.rdbuf (saved);
+   for (auto& item: threads) item.join();
+
+   if (not error.empty()) complain() << error << endl;
+   for (const auto& message: errors) {
+      if (not message.empty()) complain() << message << endl;
+   }
+   if (failure) rethrow_exception (failure);
+}
+
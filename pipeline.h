@@ -0,0 +1,49 @@
+// $Id$
+
+// pipeline -
+//    Commands joined by |, with the output of each fed line by line
+//    to the next through a bounded channel in memory, each stage on
+//    a thread of its own.
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+#include "util.h"
+
+// class pipeline -
+//    The first stage is any command, run on the calling thread with
+//    cout redirected into a channel.  Every later stage is a filter
+//    that reads lines from the channel before it and writes them to
+//    the channel after it, or for the last stage, to where cout was
+//    going.  A channel holds a few batches of lines, so no stage runs
+//    far ahead of the next, and nothing is held whole except by sort,
+//    which must see every line before it can write one.  When a
+//    stage stops reading, as head does, the stage before it is told
+//    the next time it writes: a filter simply stops, and the command
+//    is unwound by an exception out of its next write to cout, so
+//    lsr / | head 10 walks only as much of the tree as it prints.
+//    The filters are:
+//       head [N]         the first N lines, 10 if N is not given
+//       grep [-v] WORD   the lines containing WORD, or with -v, not
+//       sort [-r]        the lines in lexicographic order, or reverse
+//       wc               the numbers of lines, words and bytes
+// is_pipeline -
+//    Whether a command line has a | in it anywhere.
+// run -
+//    Runs a command line that is a pipeline.  Errors from any stage
+//    are reported once every stage has finished.  An exit in the
+//    first stage ends the shell once the pipeline has drained.
+
+class pipeline {
+   public:
+      static bool is_pipeline (const wordvec& words);
+      static void run (inode_state& state, const wordvec& words);
+};
+
+#endif
+
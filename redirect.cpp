@@ -0,0 +1,140 @@
+// $Id$
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+#include "commands.h"
+#include "dcache.h"
+#include "debug.h"
+#include "pipeline.h"
+#include "redirect.h"
+#include "sink.h"
+
+// file_sink -
+//    The sink under cout while a redirected command runs.  Each chunk
+//    is appended to the file as it is drained, or if deferred, kept
+//    until finish.  If the command takes a snapshot, the file is
+//    frozen, and is replaced by its copy before the next chunk.
+
+class file_sink: public sink {
+   private:
+      static constexpr size_t CHUNK_SIZE = 1 << 16;
+      inode_state& state;
+      inode_ptr file;
+      bool deferred;
+      bool joined {false};
+      vector<string> pending;
+      void append (string_view text) {
+         if (file->frozen()) file = state.writable (file);
+         joined = file->append (text, joined);
+      }
+   protected:
+      void drain (const char* begin, const char* end) override {
+         if (deferred) {
+            pending.emplace_back (begin, end);
+         }else {
+            append (string_view (begin, end - begin));
+         }
+      }
+      streamsize xsputn (const char* text, streamsize count) override;
+   public:
+      file_sink (inode_state& state_, inode_ptr file_, bool deferred_):
+                 sink (CHUNK_SIZE), state (state_), file (file_),
+                 deferred (deferred_) {}
+      void finish() {
+         flush();
+         for (const auto& kept: pending) append (kept);
+         pending.clear();
+         file->reindex();
+      }
+};
+
+// xsputn -
+//    With cat f >> f, what is written is the file's own buffer, which
+//    appending to it may move, so that text is copied first.  A
+//    deferred sink appends nothing until finish, and may run on
+//    another thread than whatever writes the file meanwhile, so it
+//    does not look at the file at all.
+
+streamsize file_sink::xsputn (const char* text, streamsize count) {
+   if (deferred) return sink::xsputn (text, count);
+   const string& contents = file->readfile();
+   less<const char*> before;
+   if (not before (text, contents.data())
+       and before (text, contents.data() + contents.size())) {
+      string copy (text, count);
+      return sink::xsputn (copy.data(), count);
+   }
+   return sink::xsputn (text, count);
+}
+
+static bool is_arrow (const string& word) {
+   return word == ">" or word == ">>";
+}
+
+bool redirect::is_redirected (const wordvec& words) {
+   return any_of (words.begin(), words.end(), is_arrow);
+}
+
+// open_target -
+//    The file to write to, made if it is not there, and emptied
+//    unless appending.
+
+static inode_ptr open_target (inode_state& state, const string& path,
+                              bool appending) {
+   auto found = dentry_cache::resolve (state, path);
+   if (found.node != nullptr) {
+      if (found.node->get_file() == nullptr) {
+         throw command_error (path + ": is a directory\n");
+      }
+      inode_ptr file = state.writable (found.node->shared_from_this());
+      if (not appending) file->truncate();
+      return file;
+   }
+   if (found.parent == nullptr or not found.leaf
+       or found.parent->get_directory() == nullptr) {
+      throw command_error (path + ": path not found\n");
+   }
+   auto parent = state.writable (found.parent->shared_from_this());
+   return parent->mkfile (found.missing);
+}
+
+void redirect::run (inode_state& state, const wordvec& words) {
+   auto arrow = find_if (words.begin(), words.end(), is_arrow);
+   if (arrow == words.begin()) {
+      throw command_error (*arrow + ": missing command\n");
+   }
+   if (words.end() - arrow != 2 or is_arrow (arrow[1])) {
+      throw command_error (*arrow + ": one file name expected\n");
+   }
+   wordvec command (words.begin(), arrow);
+   bool piped = pipeline::is_pipeline (command);
+   command_fn fn = piped ? nullptr : find_command_fn (command[0]);
+   if (fn == nullptr and not piped) {
+      no_such_command (command[0]);
+      return;
+   }
+
+   file_sink target (state, open_target (state, arrow[1], *arrow == ">>"),
+                     piped);
+   streambuf* saved = cout.rdbuf (&target);
+   DEBUGF ('c', command << " " << *arrow << " " << arrow[1]);
+   try {
+      if (piped) {
+         pipeline::run (state, command);
+      }else {
+         fn (state, command);
+      }
+   }catch (...) {
+      cout.rdbuf (saved);
+      cout.clear();
+      target.finish();
+      throw;
+   }
+   cout.rdbuf (saved);
+   cout.clear();
+   target.finish();
+}
+
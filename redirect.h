@@ -0,0 +1,42 @@
+// $Id$
+
+// redirect -
+//    Command lines ending in > FILE or >> FILE, whose output goes into
+//    a file in the tree rather than to the shell's output.
+
+#ifndef __REDIRECT_H__
+#define __REDIRECT_H__
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+#include "util.h"
+
+// class redirect -
+//    The command runs with a sink under cout that appends each chunk
+//    of its output to the file as it fills, as words, a newline being
+//    a break between words like any space.  No line or word is copied
+//    on the way: the chunk goes straight into the file's buffer.  With
+//    >, the file is emptied first, and with >>, it is appended to.
+//    Either makes the file if it does not exist.  The rest of the line
+//    may be a pipeline, whose last stage then writes to the file; its
+//    chunks are kept until the pipeline has finished, since the first
+//    stage may still be reading the tree.  The file is indexed for
+//    search once, when the command is done.
+// is_redirected -
+//    Whether a command line has a word that is > or >>.
+// run -
+//    Runs a command line that is redirected.  Errors in the command
+//    are reported as they would be without the redirection, and what
+//    it wrote before the error stays in the file.
+
+class redirect {
+   public:
+      static bool is_redirected (const wordvec& words);
+      static void run (inode_state& state, const wordvec& words);
+};
+
+#endif
+
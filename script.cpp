@@ -0,0 +1,122 @@
+// $Id$
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "batch.h"
+#include "bytecode.h"
+#include "commands.h"
+#include "debug.h"
+#include "pipeline.h"
+#include "redirect.h"
+#include "script.h"
+
+script_error::script_error (const string& what): runtime_error (what) {
+}
+
+// ctor -
+//    The descriptor is not needed once the file is mapped.  An empty
+//    file cannot be mapped, and is simply a script with no lines.
+
+script::script (const string& filename) {
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0) throw script_error (filename + ": " + strerror (errno));
+   struct stat status;
+   if (fstat (fd, &status) < 0) {
+      int error = errno;
+      close (fd);
+      throw script_error (filename + ": " + strerror (error));
+   }
+   length = status.st_size;
+   if (length > 0) {
+      void* mapping = mmap (nullptr, length, PROT_READ, MAP_PRIVATE,
+                            fd, 0);
+      if (mapping == MAP_FAILED) {
+         int error = errno;
+         close (fd);
+         throw script_error (filename + ": " + strerror (error));
+      }
+      madvise (mapping, length, MADV_SEQUENTIAL);
+      begin = static_cast<const char*> (mapping);
+   }
+   close (fd);
+   next = begin;
+   end = begin + length;
+   DEBUGF ('u', filename << ": " << length << " bytes mapped");
+}
+
+script::~script() {
+   if (begin != nullptr) munmap (const_cast<char*> (begin), length);
+}
+
+bool script::next_line (vector<string_view>& words) {
+   words.clear();
+   if (next == end) return false;
+   auto newline = static_cast<const char*> (memchr (next, '\n',
+                                                    end - next));
+   const char* stop = newline == nullptr ? end : newline;
+   const char* pos = next;
+   for (;;) {
+      while (pos != stop and (*pos == ' ' or *pos == '\t')) ++pos;
+      if (pos == stop) break;
+      const char* word = pos;
+      while (pos != stop and *pos != ' ' and *pos != '\t') ++pos;
+      words.emplace_back (word, pos - word);
+   }
+   next = newline == nullptr ? end : newline + 1;
+   return true;
+}
+
+void script::run (inode_state& state, size_t workers) {
+   if (bytecode::is_bytecode (contents())) {
+      bytecode::run (contents(), state);
+      return;
+   }
+   unique_ptr<batch> gathered;
+   if (workers >= 2) gathered = make_unique<batch> (state, workers);
+   vector<string_view> views;
+   wordvec words;
+   while (next_line (views)) {
+      if (views.empty() or views[0][0] == '#') continue;
+      bool compound = any_of (views.begin(), views.end(),
+                              bytecode::is_compound);
+      if (gathered != nullptr) {
+         if (not compound and batch::schedulable (views)) {
+            gathered->add (views);
+            if (gathered->size() == batch::MAX_COMMANDS) gathered->run();
+            continue;
+         }
+         gathered->run();
+      }
+      command_fn fn = compound ? nullptr : find_command_fn (views[0]);
+      if (fn == nullptr and not compound) {
+         no_such_command (views[0]);
+         continue;
+      }
+      words.resize (views.size());
+      for (size_t index = 0; index < views.size(); ++index) {
+         words[index].assign (views[index]);
+      }
+      try {
+         if (not compound) {
+            fn (state, words);
+         }else if (redirect::is_redirected (words)) {
+            redirect::run (state, words);
+         }else {
+            pipeline::run (state, words);
+         }
+      }catch (command_error& error) {
+         complain() << error.what() << endl;
+      }
+   }
+   if (gathered != nullptr) gathered->run();
+}
+
@@ -0,0 +1,68 @@
+// $Id$
+
+// script -
+//    Batch mode: running a script file without a prompt or an echo,
+//    reading it through a memory mapping rather than a stream.
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+#include "util.h"
+
+// class script -
+//    A script file mapped read only into memory.  Lines are split in
+//    place into views over the mapping, so reading a line copies and
+//    allocates nothing once the vector of views has grown to the
+//    longest line.  Words are separated by spaces and tabs, as split
+//    separates them, and a missing newline at the end does not lose
+//    the last line.
+// ctor -
+//    Maps the file, or throws script_error if it cannot.
+// contents -
+//    The whole of the file.
+// next_line -
+//    Puts the words of the next line into the vector, which is empty
+//    for a blank line, and returns false at the end of the script.
+// run -
+//    Hands a compiled script to bytecode::run.  Otherwise runs every
+//    command in the script, skipping blank lines and comments.  Each
+//    line's words are copied into one wordvec that is kept from line
+//    to line, since the commands take wordvecs; its strings keep
+//    their capacity, so this does not allocate either once they are
+//    long enough.  Errors are reported as they would be on stdin.
+//    Exit ends the script by throwing ysh_exit.  Given two workers
+//    or more, runs of mkdir and make are gathered into a batch, which
+//    runs them on that many threads before the next other command.
+//    Given one, there is no batch, and they run as they are read.
+
+class script_error: public runtime_error {
+   public:
+      explicit script_error (const string& what);
+};
+
+class script {
+   private:
+      const char* begin {nullptr};
+      const char* next {nullptr};
+      const char* end {nullptr};
+      size_t length {0};
+   public:
+      explicit script (const string& filename);
+      script (const script&) = delete;
+      script& operator= (const script&) = delete;
+      ~script();
+      string_view contents() const { return {begin, length}; }
+      bool next_line (vector<string_view>& words);
+      void run (inode_state& state, size_t workers = 1);
+};
+
+#endif
+
@@ -0,0 +1,46 @@
+// $Id$
+
+#include <cstring>
+
+using namespace std;
+
+#include "sink.h"
+
+sink::sink (size_t chunk_size_):
+            chunk (new char[chunk_size_]), chunk_size (chunk_size_) {
+   setp (chunk.get(), chunk.get() + chunk_size);
+}
+
+// flush -
+//    The chunk is emptied before drain is called, so that a drain that
+//    throws does not leave the same bytes to be drained again.
+
+void sink::flush() {
+   const char* begin = pbase();
+   const char* end = pptr();
+   setp (chunk.get(), chunk.get() + chunk_size);
+   if (begin != end) drain (begin, end);
+}
+
+int sink::overflow (int letter) {
+   flush();
+   if (letter != traits_type::eof()) {
+      *pptr() = traits_type::to_char_type (letter);
+      pbump (1);
+   }
+   return traits_type::not_eof (letter);
+}
+
+streamsize sink::xsputn (const char* text, streamsize count) {
+   if (count > epptr() - pptr()) {
+      flush();
+      if (count >= epptr() - pptr()) {
+         drain (text, text + count);
+         return count;
+      }
+   }
+   memcpy (pptr(), text, count);
+   pbump (count);
+   return count;
+}
+
@@ -0,0 +1,48 @@
+// $Id$
+
+// sink -
+//    Where the output of a command goes.  Commands format their output
+//    with cout as they always have; what is under cout decides where
+//    the bytes end up: the shell's standard output, the next stage of
+//    a pipeline, or a file redirected to.
+
+#ifndef __SINK_H__
+#define __SINK_H__
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+using namespace std;
+
+// class sink -
+//    A stream buffer that gathers what is written into a chunk of
+//    fixed size, and hands each chunk to drain when it fills, or when
+//    told to.  Writes too big to be worth copying are handed to drain
+//    whole, after what was already gathered.  The flush that endl
+//    asks for does nothing, so a command that writes a line at a time
+//    still drains a chunk at a time.  Drain may throw, and whatever
+//    is still gathered is then lost.
+// ctor -
+//    Allocates a chunk of the given size.
+// drain -
+//    Takes the bytes from begin to end, in the order they were
+//    written.  A chunk may end anywhere, even inside a word.
+// flush -
+//    Drains whatever has been gathered.
+
+class sink: public streambuf {
+   public:
+      explicit sink (size_t chunk_size);
+      void flush();
+   protected:
+      virtual void drain (const char* begin, const char* end) = 0;
+      int overflow (int letter) override;
+      streamsize xsputn (const char* text, streamsize count) override;
+      int sync() override { return 0; }
+   private:
+      unique_ptr<char[]> chunk;
+      size_t chunk_size;
+};
+
+#endif
+
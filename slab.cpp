@@ -0,0 +1,212 @@
+// $Id$
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <sys/mman.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "locks.h"
+#include "slab.h"
+
+slab_pool::backing slab_pool::mode {slab_pool::backing::SLAB};
+bool slab_pool::mode_fixed {false};
+
+static constexpr size_t NUM_CLASSES = slab_pool::MAX_OBJECT
+                                    / slab_pool::GRANULE;
+
+static unique_ptr<slab_pool>* size_classes() {
+   static unique_ptr<slab_pool> classes[NUM_CLASSES];
+   return classes;
+}
+
+slab_pool::slab_pool (size_t size):
+   object_size (max (size, sizeof (free_node))) {
+}
+
+// HEADER_SIZE -
+//    Where the first object of a chunk starts, past its header.
+
+static constexpr size_t HEADER_SIZE = 128;
+
+char* slab_pool::chunk_end (chunk* owner) const {
+   return reinterpret_cast<char*> (owner) + CHUNK_SIZE;
+}
+
+slab_pool::chunk* slab_pool::chunk_of (void* object) {
+   auto address = reinterpret_cast<uintptr_t> (object);
+   return reinterpret_cast<chunk*> (address & ~(CHUNK_SIZE - 1));
+}
+
+// map_chunk -
+//    Maps a chunk aligned on its size.  Reserved huge pages are
+//    aligned already.  Normal pages are mapped twice as large and
+//    trimmed at both ends.  With huge pages wanted and none reserved,
+//    the chunk is hinted to become a transparent huge page.
+
+static void* map_chunk (bool want_huge, bool& huge) {
+   constexpr size_t SIZE = slab_pool::CHUNK_SIZE;
+   constexpr int PROT = PROT_READ | PROT_WRITE;
+   constexpr int FLAGS = MAP_PRIVATE | MAP_ANONYMOUS;
+   huge = false;
+   if (want_huge) {
+      void* mapped = mmap (nullptr, SIZE, PROT, FLAGS | MAP_HUGETLB,
+                           -1, 0);
+      if (mapped != MAP_FAILED) {
+         huge = true;
+         return mapped;
+      }
+   }
+   void* mapped = mmap (nullptr, 2 * SIZE, PROT, FLAGS, -1, 0);
+   if (mapped == MAP_FAILED) throw bad_alloc();
+   char* start = static_cast<char*> (mapped);
+   char* aligned = reinterpret_cast<char*> (
+         (reinterpret_cast<uintptr_t> (start) + SIZE - 1) & ~(SIZE - 1));
+   if (aligned != start) munmap (start, aligned - start);
+   munmap (aligned + SIZE, start + SIZE - aligned);
+   if (want_huge) madvise (aligned, SIZE, MADV_HUGEPAGE);
+   return aligned;
+}
+
+void slab_pool::refill() {
+   static_assert (sizeof (chunk) <= HEADER_SIZE);
+   bool huge = false;
+   void* mapped = map_chunk (mode == backing::HUGE_PAGES, huge);
+   DEBUGF ('s', "pool " << object_size << ": chunk " << mapped);
+   chunk* fresh = new (mapped) chunk;
+   fresh->unused = static_cast<char*> (mapped) + HEADER_SIZE;
+   fresh->huge = huge;
+   ++chunks;
+   if (huge) ++huge_chunks;
+   add_room (fresh);
+}
+
+// add_room, drop_room -
+//    Put a chunk at the end of the list of those with room, or take
+//    it off.
+
+void slab_pool::add_room (chunk* owner) {
+   owner->has_room = true;
+   owner->prev = last_with_room;
+   owner->next = nullptr;
+   if (last_with_room != nullptr) last_with_room->next = owner;
+                             else with_room = owner;
+   last_with_room = owner;
+}
+
+void slab_pool::drop_room (chunk* owner) {
+   owner->has_room = false;
+   if (owner->prev != nullptr) owner->prev->next = owner->next;
+                          else with_room = owner->next;
+   if (owner->next != nullptr) owner->next->prev = owner->prev;
+                          else last_with_room = owner->prev;
+}
+
+// give_back -
+//    Unmaps an empty chunk.  Every object carved from it is on its
+//    free list.
+
+void slab_pool::give_back (chunk* owner) {
+   drop_room (owner);
+   char* first = reinterpret_cast<char*> (owner) + HEADER_SIZE;
+   free -= (owner->unused - first) / object_size;
+   --chunks;
+   if (owner->huge) --huge_chunks;
+   ++returned;
+   DEBUGF ('s', "pool " << object_size << ": returned " << owner);
+   munmap (owner, CHUNK_SIZE);
+}
+
+void* slab_pool::allocate() {
+   guard<mutex> held (lock);
+   if (with_room == nullptr) refill();
+   chunk* owner = with_room;
+   void* object;
+   if (owner->free_list != nullptr) {
+      --free;
+      object = owner->free_list;
+      owner->free_list = owner->free_list->next;
+   }else {
+      object = owner->unused;
+      owner->unused += object_size;
+   }
+   ++owner->live;
+   ++live;
+   if (owner->free_list == nullptr
+   and chunk_end (owner) - owner->unused
+       < static_cast<ptrdiff_t> (object_size)) {
+      drop_room (owner);
+   }
+   return object;
+}
+
+void slab_pool::deallocate (void* object) {
+   guard<mutex> held (lock);
+   chunk* owner = chunk_of (object);
+   owner->free_list = new (object) free_node {owner->free_list};
+   --owner->live;
+   --live;
+   ++free;
+   if (not owner->has_room) add_room (owner);
+   if (owner->live == 0 and with_room != last_with_room) {
+      give_back (owner);
+   }
+}
+
+slab_pool* slab_pool::for_size (size_t size) {
+   static mutex classes_lock;
+   guard<mutex> held (classes_lock);
+   mode_fixed = true;
+   if (mode == backing::HEAP or size > MAX_OBJECT) return nullptr;
+   size_t index = (size + GRANULE - 1) / GRANULE - 1;
+   auto& pool = size_classes()[index];
+   if (pool == nullptr) {
+      pool = make_unique<slab_pool> ((index + 1) * GRANULE);
+   }
+   return pool.get();
+}
+
+bool slab_pool::set_backing (backing new_mode) {
+   if (mode_fixed) return new_mode == mode;
+   mode = new_mode;
+   return true;
+}
+
+slab_pool::backing slab_pool::get_backing() {
+   return mode;
+}
+
+slab_pool::statistics slab_pool::stats() {
+   statistics result;
+   for (size_t index = 0; index < NUM_CLASSES; ++index) {
+      const auto& pool = size_classes()[index];
+      if (pool == nullptr) continue;
+      ++result.pools;
+      result.chunks += pool->chunks;
+      result.huge_chunks += pool->huge_chunks;
+      result.returned += pool->returned;
+      result.live += pool->live;
+      result.free += pool->free;
+   }
+   return result;
+}
+
+ostream& operator<< (ostream& out, slab_pool::backing mode) {
+   switch (mode) {
+      case slab_pool::backing::HEAP: return out << "heap";
+      case slab_pool::backing::SLAB: return out << "slab";
+      case slab_pool::backing::HUGE_PAGES: return out << "huge pages";
+   }
+   return out;
+}
+
+ostream& operator<< (ostream& out, const slab_pool::statistics& stats) {
+   return out << "slabs: " << stats.pools << " pools, "
+              << stats.chunks << " chunks (" << stats.huge_chunks
+              << " huge), " << stats.returned << " returned, "
+              << stats.live << " live, "
+              << stats.free << " free";
+}
+
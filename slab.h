@@ -0,0 +1,143 @@
+// $Id$
+
+// slab -
+//    Fixed size object pools carved out of large chunks, used for
+//    inodes and their contents so that creating many files does not
+//    cost one small heap allocation each.
+
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <new>
+using namespace std;
+
+// class slab_pool -
+//    Hands out objects of one size class from 2 MiB chunks.  Each
+//    chunk starts with a header holding its own intrusive free list
+//    and count of live objects, and chunks are aligned on their size,
+//    so an object finds its chunk by masking its address.  The chunks
+//    with room are kept on a list, and objects come from the first of
+//    them, so allocation favours the chunks already in use and lets
+//    the others drain.  A chunk whose last object is freed is given
+//    back to the system, unless it is the only one with room, so
+//    removing a large tree shrinks the process instead of leaving it
+//    at its high water mark.  Each pool has a lock of its own, taken
+//    while the tree is threaded, and held only to unlink or link one
+//    object.  Per thread caches of objects would take it less often,
+//    but would leave the counts stats reports up to the scheduling.
+// backing -
+//    HEAP bypasses the pools entirely and uses operator new, which
+//    is how inodes used to be allocated.  SLAB maps chunks of normal
+//    pages.  HUGE_PAGES asks for huge pages, first explicitly and
+//    then through transparent huge pages if none are reserved.  The
+//    backing can only be chosen before the first allocation.
+// for_size -
+//    The shared pool for objects of the given size, or nullptr if
+//    objects that large are not pooled.  It takes a lock, so
+//    slab_allocator asks once for each type and keeps the answer.
+
+class slab_pool {
+   public:
+      enum class backing {HEAP, SLAB, HUGE_PAGES};
+      struct statistics {
+         size_t pools {0};
+         size_t chunks {0};
+         size_t huge_chunks {0};
+         size_t returned {0};
+         size_t live {0};
+         size_t free {0};
+      };
+      static constexpr size_t CHUNK_SIZE = size_t {2} << 20;
+      static constexpr size_t GRANULE = alignof (max_align_t);
+      static constexpr size_t MAX_OBJECT = 1024;
+   private:
+      struct free_node {
+         free_node* next;
+      };
+      struct chunk {
+         chunk* prev {nullptr};
+         chunk* next {nullptr};
+         free_node* free_list {nullptr};
+         char* unused;
+         size_t live {0};
+         bool huge;
+         bool has_room {false};
+      };
+      size_t object_size;
+      chunk* with_room {nullptr};
+      chunk* last_with_room {nullptr};
+      size_t chunks {0};
+      size_t huge_chunks {0};
+      size_t returned {0};
+      size_t live {0};
+      size_t free {0};
+      mutex lock;
+      static backing mode;
+      static bool mode_fixed;
+      char* chunk_end (chunk*) const;
+      static chunk* chunk_of (void* object);
+      void refill();
+      void add_room (chunk*);
+      void drop_room (chunk*);
+      void give_back (chunk*);
+   public:
+      explicit slab_pool (size_t size);
+      slab_pool (const slab_pool&) = delete;
+      slab_pool& operator= (const slab_pool&) = delete;
+      void* allocate();
+      void deallocate (void* object);
+      static slab_pool* for_size (size_t size);
+      static bool set_backing (backing);
+      static backing get_backing();
+      static statistics stats();
+};
+
+ostream& operator<< (ostream&, slab_pool::backing);
+ostream& operator<< (ostream&, const slab_pool::statistics&);
+
+// class slab_allocator -
+//    A standard allocator over the slab pools, suitable for
+//    allocate_shared, which then places the object and its reference
+//    counts together in one pooled block.  Arrays and anything too
+//    big for a pool go to operator new.
+
+template <typename item_t>
+class slab_allocator {
+   private:
+      static slab_pool* pool_for (size_t count) {
+         if (count != 1) return nullptr;
+         static slab_pool* const pool = slab_pool::for_size (sizeof (item_t));
+         return pool;
+      }
+   public:
+      using value_type = item_t;
+      slab_allocator() = default;
+      template <typename other_t>
+      slab_allocator (const slab_allocator<other_t>&) {}
+      item_t* allocate (size_t count) {
+         slab_pool* pool = pool_for (count);
+         void* block = pool != nullptr
+                     ? pool->allocate()
+                     : ::operator new (count * sizeof (item_t));
+         return static_cast<item_t*> (block);
+      }
+      void deallocate (item_t* block, size_t count) {
+         slab_pool* pool = pool_for (count);
+         if (pool != nullptr) pool->deallocate (block);
+                         else ::operator delete (block);
+      }
+      template <typename other_t>
+      bool operator== (const slab_allocator<other_t>&) const {
+         return true;
+      }
+      template <typename other_t>
+      bool operator!= (const slab_allocator<other_t>&) const {
+         return false;
+      }
+};
+
+#endif
+
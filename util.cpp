@@ -7,6 +7,7 @@ using namespace std;
 
 #include "util.h"
 #include "debug.h"
+#include "output.h"
 
 int exit_status::status = EXIT_SUCCESS;
 static string execname_string;
@@ -57,6 +58,7 @@ wordvec split (const string& line, const string& delimiters) {
 
 ostream& complain() {
    exit_status::set (EXIT_FAILURE);
+   output::flush();
    cerr << execname() << ": ";
    return cerr;
 }
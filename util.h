@@ -10,6 +10,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 using namespace std;
 
@@ -59,10 +60,53 @@ class exit_status {
 
 wordvec split (const string& line, const string& delimiter);
 
+// path_names -
+//    The names in a pathname, in order, as views into the pathname
+//    itself.  Runs of slashes separate names, as with split (path,
+//    "/"), but nothing is copied and nothing is allocated:
+//       for (string_view name: path_names (path)) ...
+
+class path_names {
+   public:
+      class iterator {
+         friend class path_names;
+         private:
+            string_view rest;
+            string_view name;
+            explicit iterator (string_view path): rest (path) {
+               advance();
+            }
+            void advance() {
+               size_t start = rest.find_first_not_of ('/');
+               if (start == string_view::npos) {
+                  rest = name = string_view();
+                  return;
+               }
+               rest.remove_prefix (start);
+               name = rest.substr (0, rest.find ('/'));
+               rest.remove_prefix (name.size());
+            }
+         public:
+            iterator() = default;
+            string_view operator*() const { return name; }
+            iterator& operator++() { advance(); return *this; }
+            bool operator!= (const iterator& that) const {
+               return name.data() != that.name.data();
+            }
+      };
+   private:
+      string_view path;
+   public:
+      explicit path_names (string_view pathname): path (pathname) {}
+      iterator begin() const { return iterator (path); }
+      iterator end() const { return iterator(); }
+};
+
 // complain -
 //    Used for starting error messages.  Sets the exit status to
-//    EXIT_FAILURE, writes the program name to cerr, and then
-//    returns the cerr ostream.  Example:
+//    EXIT_FAILURE, flushes buffered output so that the message comes
+//    after it, writes the program name to cerr, and then returns the
+//    cerr ostream.  Example:
 //       complain() << filename << ": some problem" << endl;
 
 ostream& complain();
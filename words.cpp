@@ -0,0 +1,332 @@
+// $Id$
+
+#include <algorithm>
+
+using namespace std;
+
+#include "debug.h"
+#include "locks.h"
+#include "words.h"
+
+bool word_index::enabled_ {false};
+size_t word_index::dead {0};
+size_t word_index::postings {0};
+
+// put, reader -
+//    Variable length integers, seven bits to a byte, low bits first,
+//    with the top bit set on every byte but the last.  The reader
+//    turns a posting list back into (document, position) pairs, and
+//    can seek forward to the last skip at or before a document.
+
+static void put (vector<uint8_t>& bytes, uint32_t value) {
+   while (value >= 0x80) {
+      bytes.push_back (static_cast<uint8_t> (value | 0x80));
+      value >>= 7;
+   }
+   bytes.push_back (static_cast<uint8_t> (value));
+}
+
+class reader {
+   private:
+      const vector<word_index::skip>& skips;
+      size_t next_skip {0};
+      const uint8_t* begin;
+      const uint8_t* next;
+      const uint8_t* end;
+      uint32_t doc {0};
+      uint32_t pos {0};
+      uint32_t get() {
+         uint32_t value = 0;
+         for (int shift = 0;; shift += 7) {
+            uint8_t byte = *next++;
+            value |= static_cast<uint32_t> (byte & 0x7F) << shift;
+            if (byte < 0x80) return value;
+         }
+      }
+   public:
+      explicit reader (const word_index::posting_list& list):
+               skips (list.skips), begin (list.bytes.data()),
+               next (begin), end (begin + list.bytes.size()) {}
+      bool read (uint32_t& doc_, uint32_t& pos_) {
+         if (next == end) return false;
+         uint32_t gap = get();
+         pos = gap == 0 ? pos + get() : get();
+         doc += gap;
+         doc_ = doc;
+         pos_ = pos;
+         return true;
+      }
+      void seek (uint32_t target) {
+         auto found = upper_bound (skips.begin() + next_skip, skips.end(),
+                                   target,
+                                   [] (uint32_t wanted,
+                                       const word_index::skip& item) {
+                                      return wanted < item.doc;
+                                   });
+         size_t index = found - skips.begin();
+         if (index == next_skip) return;
+         next_skip = index;
+         const word_index::skip& item = skips[index - 1];
+         if (begin + item.offset > next) {
+            next = begin + item.offset;
+            doc = item.before;
+         }
+      }
+};
+
+void word_index::posting_list::append (uint32_t doc, uint32_t pos) {
+   if (count == 0 or doc != last_doc) {
+      if (count - at_skip >= SKIP_EVERY) {
+         skips.push_back ({doc, last_doc, uint32_t (bytes.size())});
+         at_skip = count;
+      }
+      put (bytes, doc - last_doc);
+      put (bytes, pos);
+   }else {
+      put (bytes, 0);
+      put (bytes, pos - last_pos);
+   }
+   last_doc = doc;
+   last_pos = pos;
+   ++count;
+}
+
+unordered_map<string, word_index::posting_list>& word_index::lists() {
+   static unordered_map<string, posting_list> table;
+   return table;
+}
+
+// docs -
+//    Document 0 is never used, so that the first gap is never zero.
+
+vector<word_index::document>& word_index::docs() {
+   static vector<document> table {{0, fname(), 0, false}};
+   return table;
+}
+
+unordered_map<inode_nr_t, uint32_t>& word_index::current() {
+   static unordered_map<inode_nr_t, uint32_t> table;
+   return table;
+}
+
+void word_index::build (inode* root) {
+   clear();
+   enabled_ = true;
+   vector<inode*> pending {root};
+   while (not pending.empty()) {
+      directory* dir = pending.back()->get_directory();
+      pending.pop_back();
+      for (const auto& entry: dir->get_dirents()) {
+         if (entry.node->get_directory() == nullptr) {
+            add (entry.node.get(), entry.name);
+         }else {
+            pending.push_back (entry.node.get());
+         }
+      }
+   }
+   DEBUGF ('w', stats());
+}
+
+mutex& word_index::lock() {
+   static mutex index_lock;
+   return index_lock;
+}
+
+void word_index::insert (inode* file, fname name) {
+   if (not enabled_) return;
+   guard<mutex> held (lock());
+   add (file, name);
+}
+
+// write -
+//    The new document takes its reference to the name before the old
+//    one gives its own back.
+
+void word_index::write (inode* file) {
+   if (not enabled_) return;
+   guard<mutex> held (lock());
+   auto found = current().find (file->get_inode_nr());
+   if (found == current().end()) return;
+   uint32_t doc = found->second;
+   if (docs()[doc].words == 0 and doc + 1 == docs().size()) {
+      post (file, doc);
+      return;
+   }
+   add (file, docs()[doc].name);
+   bury (doc);
+   compact();
+}
+
+void word_index::drop (inode_nr_t inode_nr) {
+   if (not enabled_) return;
+   guard<mutex> held (lock());
+   retire (inode_nr);
+   compact();
+}
+
+void word_index::renumber (inode_nr_t from, inode_nr_t to) {
+   if (not enabled_) return;
+   guard<mutex> held (lock());
+   auto found = current().find (from);
+   if (found == current().end()) return;
+   uint32_t doc = found->second;
+   current().erase (found);
+   current()[to] = doc;
+   docs()[doc].inode_nr = to;
+}
+
+void word_index::clear() {
+   for (const auto& entry: current()) {
+      name_pool::release (docs()[entry.second].name);
+   }
+   lists().clear();
+   docs().resize (1);
+   current().clear();
+   dead = 0;
+   postings = 0;
+   enabled_ = false;
+}
+
+void word_index::add (inode* file, fname name) {
+   uint32_t doc = docs().size();
+   name_pool::acquire (name);
+   docs().push_back ({file->get_inode_nr(), name, 0, true});
+   current()[file->get_inode_nr()] = doc;
+   post (file, doc);
+}
+
+void word_index::post (const inode* file, uint32_t doc) {
+   const plain_file* contents = file->get_file();
+   uint32_t nwords = contents->word_count();
+   string key;
+   for (uint32_t pos = 0; pos < nwords; ++pos) {
+      key.assign (contents->word (pos));
+      lists()[key].append (doc, pos);
+   }
+   docs()[doc].words = nwords;
+   postings += nwords;
+}
+
+void word_index::retire (inode_nr_t inode_nr) {
+   auto found = current().find (inode_nr);
+   if (found == current().end()) return;
+   bury (found->second);
+   current().erase (found);
+}
+
+void word_index::bury (uint32_t doc) {
+   docs()[doc].live = false;
+   name_pool::release (docs()[doc].name);
+   ++dead;
+}
+
+// compact -
+//    Rewrites every list without the dead documents, numbering the
+//    live ones again from 1 in the same order, so that gaps stay
+//    small.  Runs only when most documents are dead, so the cost is
+//    spread over the removals that made them so.
+
+void word_index::compact() {
+   if (dead < COMPACT_MIN or dead < current().size()) return;
+   vector<uint32_t> renumbered (docs().size(), 0);
+   vector<document> kept {docs()[0]};
+   for (uint32_t doc = 1; doc < docs().size(); ++doc) {
+      if (not docs()[doc].live) continue;
+      renumbered[doc] = kept.size();
+      current()[docs()[doc].inode_nr] = kept.size();
+      kept.push_back (docs()[doc]);
+   }
+   postings = 0;
+   for (auto entry = lists().begin(); entry != lists().end();) {
+      posting_list rewritten;
+      reader postings_in (entry->second);
+      uint32_t doc, pos;
+      while (postings_in.read (doc, pos)) {
+         if (renumbered[doc] != 0) rewritten.append (renumbered[doc], pos);
+      }
+      if (rewritten.count == 0) {
+         entry = lists().erase (entry);
+         continue;
+      }
+      rewritten.bytes.shrink_to_fit();
+      rewritten.skips.shrink_to_fit();
+      postings += rewritten.count;
+      entry->second = move (rewritten);
+      ++entry;
+   }
+   DEBUGF ('w', "compacted " << dead << " dead of " << docs().size() - 1);
+   docs() = move (kept);
+   dead = 0;
+}
+
+vector<word_index::match>
+word_index::search (const vector<string_view>& words) {
+   vector<const posting_list*> wanted;
+   string key;
+   for (string_view word: words) {
+      key.assign (word);
+      auto found = lists().find (key);
+      if (found == lists().end()) return {};
+      wanted.push_back (&found->second);
+   }
+   if (wanted.empty()) return {};
+   sort (wanted.begin(), wanted.end(),
+         [] (const posting_list* a, const posting_list* b) {
+            return a->count < b->count;
+         });
+
+   vector<uint32_t> candidates;
+   reader rarest (*wanted[0]);
+   uint32_t doc, pos;
+   while (rarest.read (doc, pos)) {
+      if (docs()[doc].live
+          and (candidates.empty() or candidates.back() != doc)) {
+         candidates.push_back (doc);
+      }
+   }
+   for (size_t index = 1; index < wanted.size(); ++index) {
+      vector<uint32_t> kept;
+      reader postings_in (*wanted[index]);
+      doc = 0;
+      bool more = true;
+      for (uint32_t candidate: candidates) {
+         if (doc < candidate) postings_in.seek (candidate);
+         while (more and doc < candidate) {
+            more = postings_in.read (doc, pos);
+         }
+         if (doc == candidate) {
+            kept.push_back (candidate);
+         }else if (not more) {
+            break;
+         }
+      }
+      candidates = move (kept);
+   }
+
+   vector<match> result;
+   for (uint32_t found: candidates) {
+      const document& file = docs()[found];
+      result.push_back ({inode_table::find (file.inode_nr), file.name});
+   }
+   DEBUGF ('w', words.size() << " words, " << result.size() << " files");
+   return result;
+}
+
+word_index::statistics word_index::stats() {
+   statistics result {lists().size(), current().size(), dead,
+                      postings, 0};
+   for (const auto& entry: lists()) {
+      result.bytes += entry.second.bytes.size()
+                    + entry.second.skips.size() * sizeof (skip);
+   }
+   return result;
+}
+
+ostream& operator<< (ostream& out,
+                     const word_index::statistics& stats) {
+   return out << "words: " << stats.words << " distinct in "
+              << stats.docs << " files, " << stats.postings
+              << " postings in " << stats.bytes << " bytes, "
+              << stats.dead << " dead files";
+}
+
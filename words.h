@@ -0,0 +1,134 @@
+// $Id$
+
+// words -
+//    An inverted index from the words in plain files to the files and
+//    positions where they occur, for searching contents without
+//    reading every file.
+
+#ifndef __WORDS_H__
+#define __WORDS_H__
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+
+// class word_index -
+//    Maps each word onto a posting list of (file, position) pairs,
+//    where the position is the word's index in the file.  The index is
+//    optional: it is off until build walks the live tree, and from
+//    then on writefile and removal keep it up to date.  Restoring a
+//    snapshot turns it off again, since the tree it describes is gone.
+//    Postings name documents, not inodes.  Each time a file is
+//    indexed it gets a new document number, higher than any before,
+//    so lists only ever grow at the end and stay sorted.  A document
+//    that is removed or reindexed is marked dead and skipped, and the
+//    lists are compacted once dead documents outnumber live ones.
+//    A document also holds the file's name, taken from the directory
+//    when the file is first indexed and kept through every reindex,
+//    so a search can print the names without looking for them.
+//    A posting list is a byte string of variable length integers: the
+//    gap from the previous document, then the position, or the gap
+//    from the previous position if the gap in documents was zero.
+//    Most postings fit in two bytes.  Every SKIP_EVERY postings or so,
+//    where a document starts, a skip records the document and the
+//    offset, so an intersection can jump over the stretches of a long
+//    list that hold none of the documents it wants.
+// enabled -
+//    Whether the index is being kept.
+// build -
+//    Indexes every plain file under the root and turns the index on.
+// insert -
+//    Indexes a file just made in the live tree, under its name.  It
+//    has no words yet, so when it is first written, if no file was
+//    indexed in between, its words go under the same document.
+// write -
+//    Indexes a file in the live tree again after it was written.
+// drop -
+//    Forgets a file that has left the live tree.
+//    All three take a lock while the tree is threaded.
+// renumber -
+//    Moves a file's document over to the inode number it was given in
+//    place of its provisional one (see inode_table::settle).
+// clear -
+//    Forgets everything and turns the index off.
+// search -
+//    The live files that contain every one of the words, with their
+//    names, in no particular order.  The names are the index's own
+//    handles, good until it next changes.  The rarest word is decoded
+//    first, and the others are only read near the documents that can
+//    still match.
+// stats -
+//    The number of distinct words, of live and dead documents, and of
+//    postings, and the bytes the postings take.
+
+class word_index {
+   public:
+      struct match {
+         inode* file;
+         fname name;
+      };
+      struct statistics {
+         size_t words;
+         size_t docs;
+         size_t dead;
+         size_t postings;
+         size_t bytes;
+      };
+      static bool enabled() { return enabled_; }
+      static void build (inode* root);
+      static void insert (inode* file, fname name);
+      static void write (inode* file);
+      static void drop (inode_nr_t inode_nr);
+      static void renumber (inode_nr_t from, inode_nr_t to);
+      static void clear();
+      static vector<match> search (const vector<string_view>& words);
+      static statistics stats();
+   private:
+      struct skip {
+         uint32_t doc;
+         uint32_t before;
+         uint32_t offset;
+      };
+      struct posting_list {
+         vector<uint8_t> bytes;
+         vector<skip> skips;
+         uint32_t count {0};
+         uint32_t at_skip {0};
+         uint32_t last_doc {0};
+         uint32_t last_pos {0};
+         void append (uint32_t doc, uint32_t pos);
+      };
+      struct document {
+         inode_nr_t inode_nr;
+         fname name;
+         uint32_t words;
+         bool live;
+      };
+      static bool enabled_;
+      static size_t dead;
+      static size_t postings;
+      static constexpr size_t COMPACT_MIN = 1024;
+      static constexpr uint32_t SKIP_EVERY = 64;
+      static unordered_map<string, posting_list>& lists();
+      static mutex& lock();
+      static vector<document>& docs();
+      static unordered_map<inode_nr_t, uint32_t>& current();
+      static void add (inode* file, fname name);
+      static void post (const inode* file, uint32_t doc);
+      static void retire (inode_nr_t inode_nr);
+      static void bury (uint32_t doc);
+      static void compact();
+      friend class reader;
+};
+
+ostream& operator<< (ostream&, const word_index::statistics&);
+
+#endif
+